@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Burst.c - Burst mode: gates the output BurstOn ms on and BurstOff * 4 ms
+ * off, the usual way to run long bangs inside the duty limits.
+ *
+ * The edges are timed on the GetTime() base by TA1 CCR2, shared with the
+ * tempo gate of Clock.c (see ArmEdge()), and applied by its interrupt through
+ * SynthGate(), so bursts cost no main loop time and land within an interrupt
+ * latency of their schedule, even when an edge is already due as CCR2 is
+ * written (see ArmEdge()). Each edge is planned from the last planned edge,
+ * not from when it was served, so the burst rate does not drift. The times
+ * come from the pots on the burst page of Manual mode or from the
+ * BURST_ON_CTL and BURST_OFF_CTL controllers. An off time of zero turns burst
+ * mode off; an on time of zero holds the output off.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+#include "Burst.h"
+
+INT8U BurstOn = 0;					/*ms*/
+INT8U BurstOff = 0;					/*4 ms steps, 0 with burst mode off*/
+static INT8U BurstRunning = FALSE;	/*Edges are being scheduled*/
+static INT8U BurstOpen;				/*State set by the last edge*/
+static INT32U BurstEdgeAt;			/*Next edge, GetTime() ticks*/
+
+/******************************************************************************
+ * BurstSetOn(INT8U) - Burst on time in ms.
+ *****************************************************************************/
+void BurstSetOn(INT8U Value){
+	if(Value != BurstOn){
+		BurstOn = Value;
+		BurstApply();
+	}else{}
+}
+/******************************************************************************
+ * BurstSetOff(INT8U) - Burst off time in 4 ms steps; 0 turns burst mode off.
+ *****************************************************************************/
+void BurstSetOff(INT8U Value){
+	if(Value != BurstOff){
+		BurstOff = Value;
+		BurstApply();
+	}else{}
+}
+/******************************************************************************
+ * BurstStop() - Turns burst mode off and releases the output.
+ *****************************************************************************/
+void BurstStop(void){
+	BurstOn = 0;
+	BurstOff = 0;
+	BurstApply();
+}
+/******************************************************************************
+ * BurstApply() - Takes up new times. A running burst keeps its phase and
+ * uses them from its next edge; a stopped one starts with an on period now.
+ *****************************************************************************/
+void BurstApply(void){
+	unsigned short state = __get_interrupt_state();
+	__disable_interrupt();
+	if((BurstOn == 0) || (BurstOff == 0)){
+		BurstRunning = FALSE;
+		SynthGate(SYNTH_GATE_BURST, (BurstOff == 0));
+	}else if(!BurstRunning){
+		BurstRunning = TRUE;
+		BurstOpen = TRUE;
+		SynthGate(SYNTH_GATE_BURST, TRUE);
+		BurstEdgeAt = GetTime() + MsToTicks(BurstOn);
+	}else{}
+	ArmEdge();
+	__set_interrupt_state(state);
+}
+/******************************************************************************
+ * BurstService() - Applies every burst edge that is due. Called from
+ * GateEdge(), which arms TA1 CCR2 for the next edge afterwards; an edge due
+ * within GATE_MIN_LEAD by then brings GateEdge() straight back here. Each
+ * edge is timed from BurstOn or BurstOff as they are now; a time that has
+ * just been set to zero stops the edges until BurstApply() settles the
+ * output.
+ *****************************************************************************/
+void BurstService(void){
+	INT16U ms;
+	while(BurstRunning && ((INT32S)(BurstEdgeAt - GetTime()) < GATE_MIN_LEAD)){
+		BurstOpen = !BurstOpen;
+		SynthGate(SYNTH_GATE_BURST, BurstOpen);
+		ms = BurstOpen ? BurstOn : ((INT16U)BurstOff << BURST_OFF_SHIFT);
+		if(ms == 0){
+			BurstRunning = FALSE;
+		}else{}
+		BurstEdgeAt += MsToTicks(ms);
+	}
+}
+/******************************************************************************
+ * BurstNext(INT32U *) - TRUE with the time of the next burst edge in At while
+ * burst mode runs. Called with interrupts disabled.
+ *****************************************************************************/
+INT8U BurstNext(INT32U *At){
+	*At = BurstEdgeAt;
+	return BurstRunning;
+}
+/******************************************************************************
+ * MsToTicks(INT16U) - ms to GetTime() ticks; 16000 is 16384 - 256 - 128.
+ *****************************************************************************/
+INT32U MsToTicks(INT16U Ms){
+	INT32U ms = Ms;
+	return (ms << 14) - (ms << 8) - (ms << 7);
+}
@@ -0,0 +1,22 @@
+/******************************************************************************
+ * Burst.h - Header for the Burst.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Private Functions
+ *****************************************************************************/
+static void BurstApply(void);
+static INT32U MsToTicks(INT16U Ms);
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void BurstSetOn(INT8U Value);
+void BurstSetOff(INT8U Value);
+void BurstStop(void);
+void BurstService(void);
+INT8U BurstNext(INT32U *At);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define BURST_OFF_SHIFT 2			/*Off time in 4 ms steps, up to 508 ms*/
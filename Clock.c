@@ -0,0 +1,357 @@
+/******************************************************************************
+ * Clock.c - Locks to MIDI Timing Clock and gates the output in musical
+ * divisions of the beat.
+ *
+ * MIDI_RX() stamps every 0xF8 with GetTime() as it arrives (ClockArrived())
+ * and queues it with the other bytes; ClockTick() does the rest when the MIDI
+ * task parses it, so the receive interrupt stays short. A second order PLL follows the clock: the phase error of each
+ * clock against its prediction moves the next prediction by 1/8 and the
+ * period by 1/64 of the error, so byte jitter on a busy link is smoothed out
+ * while tempo changes are followed within a beat. A clock that misses its
+ * prediction by more than a quarter period relocks on the raw interval.
+ *
+ * While the transport runs the gate opens at the start of every division
+ * (24 clocks per quarter note, counted from START or the song position) and
+ * closes after its length. Once locked the opening edge is placed on the
+ * predicted time of the downbeat clock rather than its arrival, and both
+ * edges are timed by TA1 CCR2, so they land within an interrupt latency of
+ * the smoothed beat. The gate only switches the output (see SynthGate());
+ * notes are still played by NOTE_ON and NOTE_OFF. The division and length
+ * come from the GATE_DIVISION_CTL and GATE_LENGTH_CTL controllers.
+ *
+ * TA1 CCR2 is shared with the burst engine of Burst.c: ArmEdge() sets it for
+ * whichever of the two has the earlier edge, and GateEdge() serves both.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+#include "Clock.h"
+
+static INT32U ClockLast;			/*Arrival of the last clock*/
+static INT32U ClockNext;			/*Predicted arrival of the next clock*/
+static INT32U ClockPeriod;			/*Smoothed clock interval*/
+static INT8U ClockLock = 0;			/*Clocks seen, up to CLOCK_LOCKED*/
+static INT8U ClockCount = 0;		/*Position of the next clock in CLOCK_CYCLE*/
+static INT8U Transport = FALSE;		/*Between START/CONTINUE and STOP*/
+static INT8U GateClocks = 0;		/*Clocks per division, 0 with the gate off*/
+static INT8U GateLength = GATE_LENGTH_DEFAULT;
+static INT8U GatePos = 0;			/*Position of the next clock in the division*/
+static INT8U GateArmed = FALSE;		/*The next downbeat's edge is scheduled*/
+static INT8U GatePending = 0;		/*GATE_OPEN | GATE_CLOSE*/
+static INT32U GateOpenAt;
+static INT32U GateCloseAt;
+static volatile INT32U ClockStamp;	/*Arrival of the last clock received*/
+static volatile INT8U ClockWaiting = 0;	/*Clocks received but not yet parsed*/
+
+/*Clocks per division by controller value: off, 1/4, 1/4T, 1/8, 1/8T, 1/16,
+ *1/16T, 1/32*/
+static const INT8U GateDivisions[GATE_DIVISIONS] = {0, 24, 16, 12, 8, 6, 4, 3};
+
+/******************************************************************************
+ * ClockArrived(INT32U) - A Timing Clock arrived at Now and was queued. Called
+ * from MIDI_RX().
+ *****************************************************************************/
+void ClockArrived(INT32U Now){
+	ClockStamp = Now;
+	ClockWaiting++;
+}
+/******************************************************************************
+ * ClockTick() - Handles the oldest queued Timing Clock, in order with the
+ * other MIDI messages. Tracks the tempo, advances the song position while
+ * the transport runs and plans the opening edge of the next division. A
+ * clock whose stamp was overwritten by a later one before it was parsed is
+ * taken as arriving on its prediction.
+ *****************************************************************************/
+void ClockTick(void){
+	INT32U now;
+	unsigned short state = __get_interrupt_state();
+	__disable_interrupt();
+	now = (ClockWaiting > 1) ? ClockNext : ClockStamp;
+	if(ClockWaiting){
+		ClockWaiting--;
+	}else{}
+	__set_interrupt_state(state);
+	UpdatePll(now);
+	if(!Transport){
+		return;
+	}else{}
+	__disable_interrupt();
+	AdvanceClock(now);
+	__set_interrupt_state(state);
+}
+/******************************************************************************
+ * AdvanceClock(INT32U) - Moves the song position and the gate on by the clock
+ * that arrived at Now. Called with interrupts disabled.
+ *****************************************************************************/
+void AdvanceClock(INT32U Now){
+	INT8U pos = GatePos;
+	ClockCount++;
+	if(ClockCount >= CLOCK_CYCLE){
+		ClockCount = 0;
+	}else{}
+	if(GateClocks == 0){
+		return;
+	}else{}
+	GatePos = (pos + 1 >= GateClocks) ? 0 : pos + 1;
+	if(ClockLock < CLOCK_PERIOD_KNOWN){			/*No tempo; leave the output on*/
+		CancelGate();
+		SynthGate(SYNTH_GATE_CLOCK, TRUE);
+		return;
+	}else{}
+	if(pos == 0){								/*Downbeat of a division*/
+		if(!GateArmed || (ClockLock < CLOCK_LOCKED)){
+			ScheduleOpen(Now);					/*Not predicted, or relocked*/
+		}else{}
+		GateArmed = FALSE;
+	}else if((GatePos == 0) && (ClockLock >= CLOCK_LOCKED)){
+		ScheduleOpen(ClockNext);
+		GateArmed = TRUE;
+	}else{}
+	GateService();
+}
+/******************************************************************************
+ * UpdatePll(INT32U) - Moves the clock prediction toward the arrival at Now.
+ * Runs with interrupts enabled; only ClockPeriod, which the TA1 interrupt
+ * reads through GateWidth(), is written with them disabled.
+ *****************************************************************************/
+void UpdatePll(INT32U Now){
+	INT32U interval = Now - ClockLast;
+	INT32U period = ClockPeriod;
+	INT32S error;
+	INT32S slip;
+	unsigned short state;
+
+	ClockLast = Now;
+	if(ClockLock == 0){
+		ClockLock = 1;
+		return;
+	}else{}
+	if((interval < CLOCK_MIN_INTERVAL) || (interval > CLOCK_MAX_INTERVAL)){
+		ClockLock = 1;							/*Clock stopped or out of range*/
+		return;
+	}else{}
+	error = (INT32S)(Now - ClockNext);
+	slip = (INT32S)(period >> CLOCK_SLIP_SHIFT);
+	if((ClockLock < CLOCK_PERIOD_KNOWN) || (error > slip) || (error < -slip)){
+		period = interval;						/*Relock*/
+		ClockNext = Now + interval;
+		ClockLock = CLOCK_PERIOD_KNOWN;
+	}else{
+		period += error >> CLOCK_FREQ_SHIFT;
+		ClockNext += period + (error >> CLOCK_PHASE_SHIFT);
+		if(ClockLock < CLOCK_LOCKED){
+			ClockLock++;
+		}else{}
+	}
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	ClockPeriod = period;
+	__set_interrupt_state(state);
+}
+/******************************************************************************
+ * ClockStart() - START; the next clock is the first beat of the song.
+ *****************************************************************************/
+void ClockStart(void){
+	__disable_interrupt();
+	ClockCount = 0;
+	GatePos = 0;
+	Transport = TRUE;
+	CancelGate();
+	SynthGate(SYNTH_GATE_CLOCK, TRUE);
+	__enable_interrupt();
+}
+/******************************************************************************
+ * ClockStop() - STOP; the position is kept and the output is left on.
+ *****************************************************************************/
+void ClockStop(void){
+	__disable_interrupt();
+	Transport = FALSE;
+	CancelGate();
+	SynthGate(SYNTH_GATE_CLOCK, TRUE);
+	__enable_interrupt();
+}
+/******************************************************************************
+ * ClockContinue() - CONTINUE from the stopped or located position.
+ *****************************************************************************/
+void ClockContinue(void){
+	__disable_interrupt();
+	Transport = TRUE;
+	CancelGate();
+	__enable_interrupt();
+}
+/******************************************************************************
+ * ClockLocate(INT16U) - Song Position Pointer, in sixteenth notes from the
+ * start of the song. Only the position within CLOCK_CYCLE matters.
+ *****************************************************************************/
+void ClockLocate(INT16U Sixteenths){
+	INT8U pos = (INT8U)(Sixteenths & SPP_CYCLE_MASK) * CLOCKS_PER_SPP;
+	__disable_interrupt();
+	ClockCount = pos;
+	if(GateClocks){
+		while(pos >= GateClocks){
+			pos -= GateClocks;
+		}
+		GatePos = pos;
+	}else{}
+	CancelGate();
+	__enable_interrupt();
+}
+/******************************************************************************
+ * ClockSetDivision(INT8U) - Gate division from a controller value; the top
+ * three bits index GateDivisions. The gate restarts at the next downbeat of
+ * the new division, and is left open when turned off.
+ *****************************************************************************/
+void ClockSetDivision(INT8U Value){
+	INT8U clocks = GateDivisions[(Value >> GATE_DIVISION_SHIFT) & (GATE_DIVISIONS - 1)];
+	INT8U pos;
+	__disable_interrupt();
+	pos = ClockCount;
+	if(clocks){
+		while(pos >= clocks){
+			pos -= clocks;
+		}
+	}else{}
+	GateClocks = clocks;
+	GatePos = pos;
+	CancelGate();
+	SynthGate(SYNTH_GATE_CLOCK, TRUE);
+	__enable_interrupt();
+}
+/******************************************************************************
+ * ClockSetLength(INT8U) - Gate length in 1/128 of the division; 0 is taken
+ * as the shortest length.
+ *****************************************************************************/
+void ClockSetLength(INT8U Value){
+	if(Value == 0){
+		Value = 1;
+	}else{}
+	GateLength = Value;
+}
+/******************************************************************************
+ * ScheduleOpen(INT32U) - Plans the opening edge of a division at At. The
+ * closing edge is planned when the opening edge is applied.
+ *****************************************************************************/
+void ScheduleOpen(INT32U At){
+	GateOpenAt = At;
+	GatePending |= GATE_OPEN;
+}
+/******************************************************************************
+ * CancelGate() - Drops the pending edges. Called with interrupts disabled.
+ *****************************************************************************/
+void CancelGate(void){
+	GatePending = 0;
+	GateArmed = FALSE;
+	ArmEdge();
+}
+/******************************************************************************
+ * GateService() - Applies every pending edge that is due and arms TA1 CCR2
+ * for the next one. An opening edge plans its closing edge; if a close from
+ * the last division is still pending then the two divisions merge. Called
+ * with interrupts disabled.
+ *****************************************************************************/
+void GateService(void){
+	INT8U edge;
+	INT32U at;
+	FOREVER(){
+		edge = NextGateEdge(&at);
+		if(edge == 0){
+			break;
+		}else if((INT32S)(at - GetTime()) >= GATE_MIN_LEAD){
+			break;
+		}else{}
+		GatePending &= ~edge;
+		if(edge == GATE_OPEN){
+			SynthGate(SYNTH_GATE_CLOCK, TRUE);
+			GateCloseAt = GateOpenAt + GateWidth();
+			GatePending |= GATE_CLOSE;
+		}else{
+			SynthGate(SYNTH_GATE_CLOCK, FALSE);
+		}
+	}
+	ArmEdge();
+}
+/******************************************************************************
+ * ArmEdge() - Arms TA1 CCR2 for the earlier of the next gate edge and the
+ * next burst edge, or disarms it when neither is pending. If the edge is
+ * already due once CCR2 is written the match may have been missed, leaving
+ * the edge a whole TA1 period late, so the interrupt is raised by hand and
+ * GateEdge() applies it at once. Called with interrupts disabled.
+ *****************************************************************************/
+void ArmEdge(void){
+	INT32U at;
+	INT32U gate;
+	INT8U armed = BurstNext(&at);
+	if(NextGateEdge(&gate) && (!armed || ((INT32S)(gate - at) < 0))){
+		at = gate;
+		armed = TRUE;
+	}else{}
+	if(armed){
+		TA1CCR2  = (INT16U)at;
+		TA1CCTL2 = CCIE;
+		if((INT32S)(at - GetTime()) < GATE_MIN_LEAD){
+			TA1CCTL2 = (CCIE | CCIFG);
+		}else{}
+	}else{
+		TA1CCTL2 = 0;
+	}
+}
+/******************************************************************************
+ * NextGateEdge(INT32U *) - The earliest pending edge, with its time in At;
+ * 0 if none is pending.
+ *****************************************************************************/
+INT8U NextGateEdge(INT32U *At){
+	if((GatePending & GATE_OPEN) &&
+	   (!(GatePending & GATE_CLOSE) || ((INT32S)(GateOpenAt - GateCloseAt) < 0))){
+		*At = GateOpenAt;
+		return GATE_OPEN;
+	}else if(GatePending & GATE_CLOSE){
+		*At = GateCloseAt;
+		return GATE_CLOSE;
+	}else{
+		return 0;
+	}
+}
+/******************************************************************************
+ * GateWidth() - ClockPeriod * GateClocks * GateLength / 128 by shift and
+ * add, one byte factor at a time. The period is taken in us so the product
+ * stays within 32 bits at 20 BPM.
+ *****************************************************************************/
+INT32U GateWidth(void){
+	INT32U acc = 0;
+	INT32U v = ClockPeriod >> GATE_US_SHIFT;
+	INT8U n = GateLength;
+	while(n){
+		if(n & 0x01){
+			acc += v;
+		}else{}
+		v <<= 1;
+		n >>= 1;
+	}
+	v = acc;
+	acc = 0;
+	n = GateClocks;
+	while(n){
+		if(n & 0x01){
+			acc += v;
+		}else{}
+		v <<= 1;
+		n >>= 1;
+	}
+	return acc >> (GATE_LENGTH_SHIFT - GATE_US_SHIFT);
+}
+/******************************************************************************
+ * GateEdge() - TA1 CCR1/CCR2/overflow interrupt. TA1 CCR2 matches the low
+ * word of the next edge once every TA1 period; matches before the edge is
+ * due are ignored.
+ *****************************************************************************/
+#pragma vector=TIMER1_A1_VECTOR
+__interrupt void GateEdge(void){
+	switch(TA1IV){
+	case TA1IV_TACCR2:
+		BurstService();
+		GateService();
+		break;
+	default:
+		break;
+	}
+}
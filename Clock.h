@@ -0,0 +1,51 @@
+/******************************************************************************
+ * Clock.h - Header for the Clock.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Private Functions
+ *****************************************************************************/
+static void UpdatePll(INT32U Now);
+static void AdvanceClock(INT32U Now);
+static void ScheduleOpen(INT32U At);
+static void CancelGate(void);
+static void GateService(void);
+static INT8U NextGateEdge(INT32U *At);
+static INT32U GateWidth(void);
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void ClockArrived(INT32U Now);
+void ClockTick(void);
+void ClockStart(void);
+void ClockStop(void);
+void ClockContinue(void);
+void ClockLocate(INT16U Sixteenths);
+void ClockSetDivision(INT8U Value);
+void ClockSetLength(INT8U Value);
+void ArmEdge(void);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+/*Tempo tracking; times are GetTime() ticks of 62.5 ns*/
+#define CLOCK_MIN_INTERVAL 100000UL		/*24 clocks per quarter at 400 BPM*/
+#define CLOCK_MAX_INTERVAL 2000000UL	/*20 BPM*/
+#define CLOCK_PERIOD_KNOWN 2			/*ClockLock values*/
+#define CLOCK_LOCKED       4			/*Edges follow the predicted clock*/
+#define CLOCK_PHASE_SHIFT  3			/*PLL phase gain 1/8*/
+#define CLOCK_FREQ_SHIFT   6			/*PLL frequency gain 1/64*/
+#define CLOCK_SLIP_SHIFT   2			/*Errors over a quarter clock relock*/
+#define CLOCK_CYCLE        48			/*Two quarters, a multiple of every division*/
+#define CLOCKS_PER_SPP     6			/*Song position counts sixteenth notes*/
+#define SPP_CYCLE_MASK     0x07			/*Sixteenths in CLOCK_CYCLE, less one*/
+
+/*Gate*/
+#define GATE_OPEN           0x01		/*Pending edges*/
+#define GATE_CLOSE          0x02
+#define GATE_DIVISIONS      8			/*Division controller value >> 4*/
+#define GATE_DIVISION_SHIFT 4
+#define GATE_LENGTH_SHIFT   7			/*Length in 1/128 of the division*/
+#define GATE_LENGTH_DEFAULT 64
+#define GATE_US_SHIFT       4			/*Ticks to us, keeps the width product in 32 bits*/
+#define GATE_MIN_LEAD       64			/*Edges due within 4 us are applied early; also burst*/
@@ -0,0 +1,46 @@
+/******************************************************************************
+ * Fixed.c - Division free arithmetic for the display and scaling paths. The
+ * MSP430G2553 has no multiplier, so every * and / on a variable becomes a
+ * library call looping over 16 bits; these loop only over the bits a constant
+ * actually has.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+#include "Fixed.h"
+
+/******************************************************************************
+ * ScaleQ8(INT16U, INT16U) - In * Q8 / 256 by shift and add, truncated. Q8 is
+ * usually a Q8() constant; one pass per bit up to its highest set bit.
+ *****************************************************************************/
+INT16U ScaleQ8(INT16U In, INT16U Q8){
+	INT32U acc = 0;
+	INT32U v = In;
+	while(Q8){
+		if(Q8 & 0x01){
+			acc += v;
+		}else{}
+		v <<= 1;
+		Q8 >>= 1;
+	}
+	return (INT16U)(acc >> 8);
+}
+/******************************************************************************
+ * ToBcd(INT16U) - Three packed BCD digits of Value by subtracting hundreds
+ * and tens, at most 18 passes. Values over BCD_MAX show as 999.
+ *****************************************************************************/
+INT16U ToBcd(INT16U Value){
+	INT16U bcd = 0;
+	if(Value > BCD_MAX){
+		Value = BCD_MAX;
+	}else{}
+	while(Value >= 100){
+		Value -= 100;
+		bcd += 0x100;
+	}
+	while(Value >= 10){
+		Value -= 10;
+		bcd += 0x10;
+	}
+	return bcd | Value;
+}
@@ -0,0 +1,17 @@
+/******************************************************************************
+ * Fixed.h - Header for the Fixed.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+INT16U ScaleQ8(INT16U In, INT16U Q8);
+INT16U ToBcd(INT16U Value);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+/*FACTOR/BOUND in 1/256, folded by the compiler; exact when BOUND divides
+ *FACTOR << 8*/
+#define Q8(FACTOR,BOUND) ((INT16U)(((INT32U)(FACTOR) << 8) / (BOUND)))
+#define BCD_MAX          999		/*Three digits*/
@@ -11,6 +11,21 @@
 #include "PCD8544.h"
 #include "includes.h"
 
+static INT8U CursorX = 0;			/*Column the next data byte lands in*/
+static INT8U CursorY = 0;			/*Bank the next data byte lands in*/
+static INT8U AddrValid = FALSE;		/*Controller address matches the cursor*/
+static INT8U BarLength[PCD8544_VBANKS];		/*Bar drawn in each bank, or BAR_UNKNOWN*/
+static INT16U BarPattern[PCD8544_VBANKS];	/*Its byte, with the rest in the high byte*/
+#if LCD_FB_BANKS
+static INT8U FrameBuffer[LCD_FB_BANKS][LCD5110_LENGTH];
+static INT8U DirtyStart[LCD_FB_BANKS];	/*First changed column*/
+static INT8U DirtyEnd[LCD_FB_BANKS];	/*One past the last changed column; 0 if clean*/
+#endif
+static RENDER_JOB RenderQueue[RENDER_QUEUE_LEN];
+static INT8U RenderHead = 0;		/*Oldest queued job*/
+static INT8U RenderCount = 0;
+INT16U RenderOverflows = 0;			/*Jobs rendered early because the queue was full*/
+
 /******************************************************************************
  * InitLCD() - Configures the hardware to communicate with the LCD and sends
  * the configuration messages for the LCD to run.
@@ -27,7 +42,32 @@ void InitLCD(void){
     WriteToLCD(LCD5110_COMMAND, PCD8544_FUNCTIONSET);
     WriteToLCD(LCD5110_COMMAND, PCD8544_DISPLAYCONTROL | PCD8544_DISPLAYNORMAL); /*Set display mode*/
 
-    ClearLCD();
+    ResetLCD();
+}
+/******************************************************************************
+ * ResetLCD() - Clears the display RAM directly and the framebuffer with it;
+ * used at start-up when the display contents are unknown.
+ *****************************************************************************/
+void ResetLCD(void){
+    INT16U c = 0;
+    SendAddr(0, 0);
+    while(c < PCD8544_MAXBYTES) {
+        WriteToLCD(LCD5110_DATA, 0);
+        c++;
+    }
+#if LCD_FB_BANKS
+    {
+        INT8U *fb = &FrameBuffer[0][0];
+        for(c = 0; c < (LCD_FB_BANKS * LCD5110_LENGTH); c++){
+            fb[c] = 0;
+        }
+        for(c = 0; c < LCD_FB_BANKS; c++){
+            DirtyEnd[c] = 0;
+        }
+    }
+#endif
+    ForgetBars();
+    SetAddr(0, 0);
 }
 /******************************************************************************
  * WriteStringToLCD(const INT8U *)
@@ -44,25 +84,70 @@ void WriteStringToLCD(const INT8U *str) {
 void WriteCharToLCD(INT8U c) {
     INT8U i;
     for(i = 0; i < 5; i++) {
-        WriteToLCD(LCD5110_DATA, font[c - 0x20][i]);
+        WriteDataToLCD(font[c - 0x20][i]);
     }
-    WriteToLCD(LCD5110_DATA, 0);
+    WriteDataToLCD(0);
+}
+/******************************************************************************
+ * WriteNumberToLCD(INT16U) - Writes a three digit decimal number, see ToBcd().
+ *****************************************************************************/
+void WriteNumberToLCD(INT16U Number) {
+    INT16U bcd = ToBcd(Number);
+    WriteCharToLCD((bcd >> 8) + 0x30);
+    WriteCharToLCD(((bcd >> 4) & 0x0F) + 0x30);
+    WriteCharToLCD((bcd & 0x0F) + 0x30);
 }
 /******************************************************************************
- * WriteBlockToLCD(INT8U, INT8U) - Writes a line to the LCD defined by byte,
- * over the length of length.
+ * WriteBlockToLCD(INT8U, INT8U, INT8U) - Writes a line to the LCD defined by
+ * byte, over the length of length. The rest of the bank is filled with rest.
  *****************************************************************************/
-void WriteBlockToLCD(INT8U byte, INT8U length) {
+void WriteBlockToLCD(INT8U byte, INT8U rest, INT8U length) {
     INT8U c = 0;
     while(c < length) {
-        WriteToLCD(LCD5110_DATA, byte);
+        WriteDataToLCD(byte);
         c++;
     }
-    while(c < LCD5110_LENGTH) {      /*Clear rest of bank*/
-          WriteToLCD(LCD5110_DATA, 0);
+    while(c < LCD5110_LENGTH) {      /*Fill rest of bank*/
+          WriteDataToLCD(rest);
           c++;
       }
 }
+/******************************************************************************
+ * WriteBarToLCD(INT8U, INT16U, INT8U) - Moves the bar in bank to length
+ * columns of the low byte of pattern over a background of its high byte.
+ * Only the columns between the old and the new end are sent, from the old
+ * end or the new one; a bank without a known bar of the same pattern is
+ * drawn in full.
+ *****************************************************************************/
+void WriteBarToLCD(INT8U bank, INT16U pattern, INT8U length) {
+    INT8U old = BarLength[bank];
+    INT8U c;
+    if((old == BAR_UNKNOWN) || (BarPattern[bank] != pattern)) {
+        SetAddr(0, bank);
+        WriteBlockToLCD((INT8U)pattern, (INT8U)(pattern >> 8), length);
+    } else if(length > old) {
+        SetAddr(old, bank);
+        for(c = old; c < length; c++) {
+            WriteDataToLCD((INT8U)pattern);
+        }
+    } else {
+        SetAddr(length, bank);
+        for(c = length; c < old; c++) {
+            WriteDataToLCD((INT8U)(pattern >> 8));
+        }
+    }
+    BarLength[bank] = length;
+    BarPattern[bank] = pattern;
+}
+/******************************************************************************
+ * ForgetBars() - Marks every bank as holding no known bar.
+ *****************************************************************************/
+void ForgetBars(void) {
+    INT8U i;
+    for(i = 0; i < PCD8544_VBANKS; i++) {
+        BarLength[i] = BAR_UNKNOWN;
+    }
+}
 
 /******************************************************************************
  * WriteToLCD(INT8U, INT8U) - Sends a byte to the LCD, and sets the data/command pin
@@ -83,9 +168,10 @@ void WriteToLCD(INT8U dataCommand, INT8U data) {
  *****************************************************************************/
 void ClearLCD(void) {
     INT16U c = 0;
+    ForgetBars();
     SetAddr(0, 0);
     while(c < PCD8544_MAXBYTES) {
-        WriteToLCD(LCD5110_DATA, 0);
+        WriteDataToLCD(0);
         c++;
     }
     SetAddr(0, 0);
@@ -95,19 +181,216 @@ void ClearLCD(void) {
  *****************************************************************************/
 void ClearBank(INT8U bank) {
     INT8U c = 0;
+    BarLength[bank] = BAR_UNKNOWN;
     SetAddr(0, bank);
     while(c < PCD8544_HPIXELS) {
-        WriteToLCD(LCD5110_DATA, 0);
+        WriteDataToLCD(0);
         c++;
     }
     SetAddr(0, bank);
 }
 /******************************************************************************
- * SetAddr(INT8U, INT8U) - Sets the current LCD cursor coordinates.
+ * SetAddr(INT8U, INT8U) - Sets the current LCD cursor coordinates. The address
+ * is only sent to the controller by the next write outside the framebuffer.
  *****************************************************************************/
 void SetAddr(INT8U xAddr, INT8U yAddr) {
+    CursorX = xAddr;
+    CursorY = yAddr;
+    AddrValid = FALSE;
+}
+/******************************************************************************
+ * SendAddr(INT8U, INT8U) - Sends the cursor coordinates to the controller.
+ *****************************************************************************/
+void SendAddr(INT8U xAddr, INT8U yAddr) {
     WriteToLCD(LCD5110_COMMAND, PCD8544_SETXADDR | xAddr);
     WriteToLCD(LCD5110_COMMAND, PCD8544_SETYADDR | yAddr);
 }
-
-
+/******************************************************************************
+ * WriteDataToLCD(INT8U) - Writes a data byte at the cursor and advances it the
+ * way the controller does. Banks inside the framebuffer band are only written
+ * to RAM and the changed columns marked dirty; other banks go straight out.
+ *****************************************************************************/
+void WriteDataToLCD(INT8U data) {
+#if LCD_FB_BANKS
+    INT8U bank = CursorY - LCD_FB_FIRST_BANK;
+    if(bank < LCD_FB_BANKS){
+        if(FrameBuffer[bank][CursorX] != data){
+            FrameBuffer[bank][CursorX] = data;
+            if(DirtyEnd[bank] == 0){
+                DirtyStart[bank] = CursorX;
+                DirtyEnd[bank] = CursorX + 1;
+            }else if(CursorX < DirtyStart[bank]){
+                DirtyStart[bank] = CursorX;
+            }else if(CursorX >= DirtyEnd[bank]){
+                DirtyEnd[bank] = CursorX + 1;
+            }else{}
+        }else{}
+        AddrValid = FALSE;
+    }else
+#endif
+    {
+        if(!AddrValid){
+            SendAddr(CursorX, CursorY);
+            AddrValid = TRUE;
+        }else{}
+        WriteToLCD(LCD5110_DATA, data);
+    }
+    CursorX++;
+    if(CursorX >= LCD5110_LENGTH){
+        CursorX = 0;
+        CursorY++;
+        if(CursorY >= PCD8544_VBANKS){
+            CursorY = 0;
+        }else{}
+    }else{}
+}
+/******************************************************************************
+ * FlushLCD() - Sends the dirty column span of the first dirty framebuffer bank
+ * with one address set. Returns FALSE once every bank is clean.
+ *****************************************************************************/
+INT8U FlushLCD(void) {
+#if LCD_FB_BANKS
+    INT8U bank;
+    INT8U c;
+    for(bank = 0; bank < LCD_FB_BANKS; bank++){
+        if(DirtyEnd[bank]){
+            SendAddr(DirtyStart[bank], bank + LCD_FB_FIRST_BANK);
+            for(c = DirtyStart[bank]; c < DirtyEnd[bank]; c++){
+                WriteToLCD(LCD5110_DATA, FrameBuffer[bank][c]);
+            }
+            DirtyEnd[bank] = 0;
+            AddrValid = FALSE;
+            return TRUE;
+        }else{}
+    }
+#endif
+    return FALSE;
+}
+/******************************************************************************
+ * QueueJob(INT8U, INT8U, INT8U, INT16U, const INT8U *) - Adds a render job;
+ * X is a bar's length. A queued job of the same type and position, or a bar
+ * in the same bank, is updated in place instead, unless a clear was queued
+ * after it, so a storm of redraws collapses to one. A full queue renders its
+ * oldest job to make room.
+ *****************************************************************************/
+void QueueJob(INT8U Type, INT8U X, INT8U Y, INT16U Value, const INT8U *Str) {
+    RENDER_JOB *job = 0;
+    INT8U kind = RENDER_KIND(Type, Y);
+    INT8U i = RenderCount;
+    while(i){
+        i--;
+        job = &RenderQueue[(RenderHead + i) & RENDER_QUEUE_MASK];
+        if(job->Kind >= RENDER_KIND(RENDER_CLEAR_BANK, 0)){
+            job = 0;
+            i = 0;
+        }else if((job->Kind == kind) && ((job->X == X) || (Type == RENDER_BAR))){
+            i = 0;
+        }else{
+            job = 0;
+        }
+    }
+    if(!job){
+        if(RenderCount >= RENDER_QUEUE_LEN){
+            RenderOverflows++;
+            RenderJob();
+        }else{}
+        job = &RenderQueue[(RenderHead + RenderCount) & RENDER_QUEUE_MASK];
+        job->Kind = kind;
+        RenderCount++;
+    }else{}
+    job->X = X;
+    if(Type == RENDER_STRING){
+        job->Data.Str = Str;
+    }else{
+        job->Data.Value = Value;
+    }
+}
+/******************************************************************************
+ * QueueString(INT8U, INT8U, const INT8U *) - Str must stay valid until drawn.
+ *****************************************************************************/
+void QueueString(INT8U xAddr, INT8U yAddr, const INT8U *Str) {
+    QueueJob(RENDER_STRING, xAddr, yAddr, 0, Str);
+}
+/******************************************************************************
+ * QueueNumber(INT8U, INT8U, INT16U)
+ *****************************************************************************/
+void QueueNumber(INT8U xAddr, INT8U yAddr, INT16U Number) {
+    QueueJob(RENDER_NUMBER, xAddr, yAddr, Number, 0);
+}
+/******************************************************************************
+ * QueueChar(INT8U, INT8U, INT8U)
+ *****************************************************************************/
+void QueueChar(INT8U xAddr, INT8U yAddr, INT8U c) {
+    QueueJob(RENDER_CHAR, xAddr, yAddr, c, 0);
+}
+/******************************************************************************
+ * QueueBar(INT8U, INT8U, INT8U) - A full width bank of byte over length
+ * columns, see WriteBarToLCD().
+ *****************************************************************************/
+void QueueBar(INT8U bank, INT8U byte, INT8U length) {
+    QueueJob(RENDER_BAR, length, bank, byte, 0);
+}
+/******************************************************************************
+ * QueueGauge(INT8U, INT8U, INT8U, INT8U) - A bar of byte over length columns
+ * drawn on a background of rest, e.g. a thick segment over an underline.
+ *****************************************************************************/
+void QueueGauge(INT8U bank, INT8U byte, INT8U rest, INT8U length) {
+    QueueJob(RENDER_BAR, length, bank, ((INT16U)rest << 8) | byte, 0);
+}
+/******************************************************************************
+ * QueueClearBank(INT8U)
+ *****************************************************************************/
+void QueueClearBank(INT8U bank) {
+    QueueJob(RENDER_CLEAR_BANK, 0, bank, 0, 0);
+}
+/******************************************************************************
+ * QueueClear() - Drops every queued job; the clear would erase them anyway.
+ *****************************************************************************/
+void QueueClear(void) {
+    RenderCount = 0;
+    QueueJob(RENDER_CLEAR, 0, 0, 0, 0);
+}
+/******************************************************************************
+ * RenderJob() - Draws the oldest queued job, or flushes one framebuffer bank
+ * once the queue is empty. Returns FALSE when there is nothing left to do.
+ * Text drawn into a bank makes its bar unknown.
+ *****************************************************************************/
+INT8U RenderJob(void) {
+    RENDER_JOB *job;
+    INT8U bank;
+    if(RenderCount){
+        job = &RenderQueue[RenderHead];
+        RenderHead = (RenderHead + 1) & RENDER_QUEUE_MASK;
+        RenderCount--;
+        bank = job->Kind & 0x0F;
+        if(job->Kind < RENDER_KIND(RENDER_BAR, 0)){
+            SetAddr(job->X, bank);
+            BarLength[bank] = BAR_UNKNOWN;
+        }else{}
+        switch(job->Kind >> 4){
+        case RENDER_STRING:
+            WriteStringToLCD(job->Data.Str);
+            break;
+        case RENDER_NUMBER:
+            WriteNumberToLCD(job->Data.Value);
+            break;
+        case RENDER_CHAR:
+            WriteCharToLCD((INT8U)job->Data.Value);
+            break;
+        case RENDER_BAR:
+            WriteBarToLCD(bank, job->Data.Value, job->X);
+            break;
+        case RENDER_CLEAR_BANK:
+            ClearBank(bank);
+            break;
+        case RENDER_CLEAR:
+            ClearLCD();
+            break;
+        default:
+            break;
+        }
+        return TRUE;
+    }else{
+        return FlushLCD();
+    }
+}
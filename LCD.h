@@ -17,18 +17,56 @@
 #define LCD5110_LENGTH 84
 #define TOPLINE 0x01
 #define UNDERLINE 0x08
+#define THICKLINE 0x1C
 #define BLOCK 0xFF
 #define MICRO 0x80
 
+/*Framebuffer band; banks outside it are written straight to the controller.
+ *Even one bank does not fit the G2553's RAM beside the stack, so the band is
+ *off there and only kept for parts with more RAM*/
+#define LCD_FB_FIRST_BANK 2		/*Frequency note and bar*/
+#define LCD_FB_BANKS      0		/*86 bytes of RAM a bank; 0 disables, 6 shadows the whole display*/
+
+/*Bar Widget Defines*/
+#define BAR_UNKNOWN       0xFF	/*Bank contents not a known bar; redrawn in full*/
+
+/*Render Queue Defines*/
+#define RENDER_QUEUE_LEN  8		/*Must be a power of two*/
+#define RENDER_QUEUE_MASK (RENDER_QUEUE_LEN - 1)
+#define RENDER_STRING     0
+#define RENDER_NUMBER     1
+#define RENDER_CHAR       2
+#define RENDER_BAR        3		/*Text jobs must stay before it*/
+#define RENDER_CLEAR_BANK 4		/*Clears must stay last; they end coalescing*/
+#define RENDER_CLEAR      5
+#define RENDER_KIND(Type, Y) (((Type) << 4) | (Y))	/*Job type and bank; sorts by type*/
+
 #define SPI_MSB_FIRST UCB0CTL0 |= UCMSB
 #define SPI_LSB_FIRST UCB0CTL0 &= ~UCMSB s
 
 void WriteStringToLCD(const INT8U *string);
 void WriteCharToLCD(INT8U c);
-void WriteBlockToLCD(INT8U byte, INT8U length);
+void WriteNumberToLCD(INT16U Number);
+void WriteBlockToLCD(INT8U byte, INT8U rest, INT8U length);
+void WriteBarToLCD(INT8U bank, INT16U pattern, INT8U length);
+void ForgetBars(void);
 void WriteToLCD(INT8U dataCommand, INT8U data);
+void WriteDataToLCD(INT8U data);
 void ClearLCD(void);
 void ClearBank(INT8U bank);
 void SetAddr(INT8U xAddr, INT8U yAddr);
+void SendAddr(INT8U xAddr, INT8U yAddr);
+INT8U FlushLCD(void);
+void ResetLCD(void);
 void InitLCD(void);
 
+void QueueJob(INT8U Type, INT8U X, INT8U Y, INT16U Value, const INT8U *Str);
+void QueueString(INT8U xAddr, INT8U yAddr, const INT8U *Str);
+void QueueNumber(INT8U xAddr, INT8U yAddr, INT16U Number);
+void QueueChar(INT8U xAddr, INT8U yAddr, INT8U c);
+void QueueBar(INT8U bank, INT8U byte, INT8U length);
+void QueueGauge(INT8U bank, INT8U byte, INT8U rest, INT8U length);
+void QueueClearBank(INT8U bank);
+void QueueClear(void);
+INT8U RenderJob(void);
+
@@ -7,234 +7,880 @@
  * Nikolas Knutson-Bradac
  * Date of Last Revision: 06.03.2013
  *****************************************************************************/
-#include "MIDI.h"
 #include "includes.h"
+#include "MIDI.h"
 
 
-INT8U MidiRxFlag = FALSE;
-static INT8U MidiByte;
-static INT8U Status;
+INT16U MidiRxOverflows = 0;		/*Bytes dropped because the FIFO was full*/
+INT8U MidiRxHighWater = 0;		/*Deepest FIFO level seen since reset*/
+static volatile INT8U MidiRxBuffer[MIDI_RX_BUFF_LEN];
+static volatile INT8U MidiRxHead = 0;	/*Only written by MIDI_RX()*/
+static volatile INT8U MidiRxTail = 0;	/*Only written by HandleMidiFrameTask()*/
+INT16U MidiTxOverflows = 0;		/*THRU bytes dropped because the TX ring was full*/
+static volatile INT8U MidiTxBuffer[MIDI_TX_BUFF_LEN];
+static volatile INT8U MidiTxHead = 0;	/*Written with interrupts disabled*/
+static volatile INT8U MidiTxTail = 0;	/*Only written by MIDI_TX()*/
+static INT8U TxRunning = NO_STATUS;	/*Running status on MIDI out*/
+static INT8U ThruStatus = NO_STATUS;	/*Running status of the relayed input*/
+static INT8U ThruDrop = FALSE;		/*Data bytes of ThruStatus are filtered out*/
+static INT8U ThruLeft = 0;			/*Data bytes left in the relayed message*/
+static INT8U ThruSkip = FALSE;		/*Part of the relayed message was held back*/
+static INT8U ThruHold = FALSE;		/*A reply is being queued, see MidiTxHold()*/
+static INT8U (*volatile TxSource)(INT8U *Byte) = 0;	/*Feeds MIDI out after the ring, see MidiTxStream()*/
+INT8U ThruFilter = THRU_FILTER;		/*THRU_ options, see Store.c*/
+#if MIDI_LATENCY
+INT16U LatencyHist[LATENCY_BUCKETS];		/*NOTE_ON to output latency, log2 us buckets*/
+INT16U LatencyMax = 0;						/*Worst latency in us*/
+static volatile INT16U MidiRxStamp[MIDI_RX_BUFF_LEN];	/*Arrival of each FIFO byte, us*/
+static INT16U ByteStamp;					/*Arrival of the byte being parsed*/
+static INT8U LatencyPending = FALSE;		/*A NOTE_ON waits for UpdateSynth()*/
+#endif
+static INT8U Status = NO_STATUS;	/*Running status*/
+static INT8U DataCount = 0;			/*Data bytes received for Status*/
+static const MIDI_HANDLER *Handler;	/*Table entry for Status*/
 static MIDI_STRUCT DataBytes;
-static MIDI_STRUCT NoteBuffer[NOTE_BUFF_LEN];
-static INT16U Bend = BEND_CENTER;
-static const MIDI_STRUCT EmptyStruct = {0};
+static NOTE_NODE NotePool[NOTE_POOL_LEN];	/*Held notes, most recent at NoteHead*/
+static INT8U NoteHead = NO_NOTE;
+static INT8U NoteFree = NO_NOTE;			/*Released slots linked through Link*/
+static INT8U NoteUsed = 0;					/*Slots handed out since the last clear*/
+static INT8U OutputSlot = NO_NOTE;			/*Slot of the note on the output*/
+INT8U MidiChannel = CONTROLLER_CHANNEL;	/*Basic channel, see Store.c*/
+static INT16U ChannelMask = 1 << CONTROLLER_CHANNEL;	/*Channels played*/
+static INT8U RxChannel = CONTROLLER_CHANNEL;	/*Channel of the message being handled*/
+INT8U NotePriority = NOTE_PRIORITY;
+static INT16S BendValue[MIDI_CHANNELS];	/*14 bit bend off center, per channel*/
+INT8U BendRange = BEND_RANGE;		/*Semitones at full bend*/
+static INT8U RpnMsb = RPN_NULL;		/*Registered parameter selected for data entry*/
+static INT8U RpnLsb = RPN_NULL;
+static INT8U Polyphony = FALSE;		/*Set by the poly/mono mode controllers*/
+static const INT16U ChannelBits[MIDI_CHANNELS] = {
+	0x0001,0x0002,0x0004,0x0008,0x0010,0x0020,0x0040,0x0080,
+	0x0100,0x0200,0x0400,0x0800,0x1000,0x2000,0x4000,0x8000
+};
 
 extern INT8U Frequency;
 extern INT8U OnTime;
 extern INT8U Mode;
+extern volatile INT8U KernelEvents;
+
+/*Channel message handlers indexed by the status high nibble*/
+static const MIDI_HANDLER ChannelHandlers[16] = {
+	{0, FALSE, 0},					/*0x0_ - 0x7_ are data bytes*/
+	{0, FALSE, 0},
+	{0, FALSE, 0},
+	{0, FALSE, 0},
+	{0, FALSE, 0},
+	{0, FALSE, 0},
+	{0, FALSE, 0},
+	{0, FALSE, 0},
+	{2, TRUE,  NoteOff},			/*0x8_*/
+	{2, TRUE,  NoteOn},				/*0x9_*/
+	{2, TRUE,  KeyPressure},		/*0xA_*/
+	{2, FALSE, ControllerChange},	/*0xB_*/
+	{1, FALSE, ProgramChange},		/*0xC_*/
+	{1, TRUE,  ChannelPressure},	/*0xD_*/
+	{2, TRUE,  PitchBend},			/*0xE_*/
+	{0, FALSE, 0}					/*0xF_ uses SystemHandlers*/
+};
+/*System message handlers indexed by the status low nibble*/
+static const MIDI_HANDLER SystemHandlers[16] = {
+	{1, FALSE, SystemExclusive},	/*0xF0 each data byte is dispatched*/
+	{1, FALSE, 0},					/*0xF1 time code quarter frame*/
+	{2, FALSE, SongPosition},		/*0xF2*/
+	{1, FALSE, SongSelect},			/*0xF3*/
+	{0, FALSE, 0},					/*0xF4 undefined*/
+	{1, FALSE, BusSelect},			/*0xF5*/
+	{0, FALSE, TuneRequest},		/*0xF6*/
+	{0, FALSE, EndOfSystemExclusive},/*0xF7*/
+	{0, FALSE, TimingTick},			/*0xF8*/
+	{0, FALSE, 0},					/*0xF9 undefined*/
+	{0, FALSE, StartSong},			/*0xFA*/
+	{0, FALSE, ContinueSong},		/*0xFB*/
+	{0, FALSE, StopSong},			/*0xFC*/
+	{0, FALSE, 0},					/*0xFD undefined*/
+	{0, FALSE, ActiveSensing},		/*0xFE*/
+	{0, FALSE, SystemReset}			/*0xFF*/
+};
 
 /******************************************************************************
- * HandleMidiFrameTask() - Build and process MIDI frame.
+ * HandleMidiFrameTask() - Drain every byte waiting in the receive FIFO and
+ * build MIDI frames from them. Bytes received in Manual mode are discarded,
+ * except Timing Clocks, which keep the tempo tracked in both modes.
  *****************************************************************************/
 void HandleMidiFrameTask(void){
-  static INT8U bytepos = UPPER;
-	if(MidiRxFlag){
-		MidiRxFlag = FALSE;
-		if(Mode == MIDI_MODE){
-			if(MidiByte & STATUS_BIT){			/*New status*/
-				Status = MidiByte;
-				if(Status >= TUNE_REQUEST){		/*Messages with no data bytes*/
-					DataBytes.Upper = 0x00;
-					DataBytes.Lower = 0x00;
-					ProcessMidiData();
+	INT8U tail;
+	INT8U byte;
+	tail = MidiRxTail;
+	while(tail != MidiRxHead){
+		byte = MidiRxBuffer[tail];
+		if((Mode == MIDI_MODE) || (byte == TIMING_TICK)){
+#if MIDI_LATENCY
+			ByteStamp = MidiRxStamp[tail];
+#endif
+			ParseMidiByte(byte);
+		}else{} /*In Manual Mode*/
+		tail = (tail + 1) & MIDI_RX_BUFF_MASK;
+		MidiRxTail = tail;				/*Release slot to MIDI_RX()*/
+	}
+}
+/******************************************************************************
+ * ParseMidiByte(INT8U) - Byte at a time MIDI state machine. A status byte
+ * selects its handler table entry and restarts the data count; the message is
+ * processed once the entry's data length is reached. Channel messages keep
+ * running status, system common messages cancel it and real-time messages are
+ * processed immediately without disturbing a message in progress. Any status
+ * but the F7 that ends it drops a SysEx message being collected, so a stray
+ * F7 never runs a message cut short by another status. Channel messages are
+ * handled on the channels in ChannelMask; CHANNEL_ENABLE_CTL is heard on
+ * every channel so a channel can be switched on from itself.
+ *****************************************************************************/
+void ParseMidiByte(INT8U MidiByte){
+	if(MidiByte >= TIMING_TICK){						/*Real-time*/
+		ProcessMidiData(MidiByte, &SystemHandlers[MidiByte & CHANNEL_MASK]);
+	}else if(MidiByte & STATUS_BIT){					/*New status*/
+		if((MidiByte != END_OF_SYSTEM_EXCLUSIVE) || (Status != SYSTEM_EXCLUSIVE)){
+			SysExStart();								/*Drops an unterminated one*/
+		}else{}
+		Status = MidiByte;
+		DataCount = 0;
+		if(Status >= SYSTEM_EXCLUSIVE){
+			Handler = &SystemHandlers[Status & CHANNEL_MASK];
+			if(Handler->Length == 0){					/*No data bytes*/
+				ProcessMidiData(Status, Handler);
+				Status = NO_STATUS;
+			}else{}
+		}else{
+			Handler = &ChannelHandlers[Status >> 4];
+		}
+	}else if(Status != NO_STATUS){						/*Data byte*/
+		if(DataCount == 0){
+			DataBytes.Upper = MidiByte;
+		}else{
+			DataBytes.Lower = MidiByte;
+		}
+		DataCount++;
+		if(DataCount >= Handler->Length){				/*Message complete*/
+			DataCount = 0;
+			if(Status >= SYSTEM_EXCLUSIVE){
+				ProcessMidiData(Status, Handler);
+				if(Status != SYSTEM_EXCLUSIVE){
+					Status = NO_STATUS;
 				}else{}
-			}else if((Status == CHANNEL_PRESSURE)||(Status == PROGRAM_CHANGE)||(Status == SONG_SELECT)||(Status == BUS_SELECT)){	/*Messages with one data byte*/
-				DataBytes.Upper = 0x00;
-				DataBytes.Lower = MidiByte;
-				ProcessMidiData();
-			}else{								/*Messages with two data bytes*/
-				if(bytepos == UPPER){
-					DataBytes.Upper = MidiByte;
-					bytepos = LOWER;
-				}else{
-					DataBytes.Lower = MidiByte;
-					bytepos = UPPER;
-					ProcessMidiData();
-				}
+			}else{
+				RxChannel = Status & CHANNEL_MASK;
+				if((ChannelMask & ChannelBits[RxChannel]) ||
+				   ((Handler->Handler == ControllerChange) && (DataBytes.Upper == CHANNEL_ENABLE_CTL))){
+					ProcessMidiData(Status, Handler);
+				}else{}									/*Channel not played*/
 			}
-		}else{} /*In Manual Mode*/
-	}else{}		/*No data to process*/
+		}else{}
+	}else{}												/*No status yet*/
 }
 /******************************************************************************
  * UpdateSynth() - Update the output timer's pitch and duty cycle from the
- * output index of note buffer and other midi objects.
+ * held note selected by NotePriority and other midi objects. In poly mode the
+ * first SYNTH_VOICES selected notes each drive a voice. Each note is bent by
+ * its own channel's pitch bend.
  *****************************************************************************/
 void UpdateSynth(void){
-	OnTime = NoteBuffer[OUTPUT].VELOCITY;
-	Frequency = NoteBuffer[OUTPUT].KEY;
-	if(Bend != BEND_CENTER){	   /*Check for Bend*/
-		Frequency = Frequency - ((Bend-BEND_CENTER) >> 8);
-	}else{}
-	if(Frequency > MAX_FREQUENCY){
-		Frequency = MAX_FREQUENCY;
-	}else{}
+	INT8U i;
+	INT8U count;
+	INT8U slots[SYNTH_VOICES];
+	INT32U period;
+	INT16S offset;
+	count = SelectNotes(slots, Polyphony ? SYNTH_VOICES : 1);
+	if(count){
+		OutputSlot = slots[OUTPUT];
+		offset = ChannelBend(NOTE_CHANNEL(OutputSlot));
+		OnTime = NotePool[OutputSlot].Velocity;
+		Frequency = BendKey(NotePool[OutputSlot].Key, offset);
+		period = BendPeriod(NotePool[OutputSlot].Key, offset);
+	}else{
+		OutputSlot = NO_NOTE;
+		OnTime = 0;
+		Frequency = 0;
+		period = 0;
+	}
 	if(OnTime > MAX_ONTIME){
 		OnTime = MAX_ONTIME;
 	}else{}
-	TA0CCR0 = PeriodLookup[Frequency];
-	TA0CCR1 = OnTimeLookup[OnTime];
+	if(Polyphony){
+		SynthSetVoice(OUTPUT, period, OnTimeTable[OnTime]);
+		for(i=OUTPUT+1;i<SYNTH_VOICES;i++){
+			if(i < count){
+				SynthSetVoice(i, BendPeriod(NotePool[slots[i]].Key,
+											 ChannelBend(NOTE_CHANNEL(slots[i]))),
+							  OnTimeTable[NotePool[slots[i]].Velocity & MAX_ONTIME]);
+			}else{
+				SynthSetVoice(i, 0, 0);
+			}
+		}
+	}else{
+		SynthSetMono(period, OnTimeTable[OnTime]);
+	}
+#if MIDI_LATENCY
+	if(LatencyPending){							/*New values are in TA0*/
+		LatencyPending = FALSE;
+		RecordLatency((INT16U)(GetTime() >> LATENCY_SHIFT) - ByteStamp);
+	}else{}
+#endif
+	TRACE_EVENT(TRACE_SYNTH, Frequency);
 }
-
 /******************************************************************************
- * NoteOff() - Scan the note buffer for the note to be turned off; if it is
- * present turn off note and shift higher indexed objects toward output.
- * Otherwise disregard.
+ * BendKey(INT8U, INT16S) - The key nearest to a key bent by Offset (1/256
+ * semitones), for display.
  *****************************************************************************/
-void NoteOff(void){
+INT8U BendKey(INT8U Key, INT16S Offset){
+	INT16U note = ((INT16U)Key << 8) + Offset + 0x80;
+	if(note >= NOTE_WRAPPED){					/*Bent below key 0*/
+		return 0;
+	}else if(note > (MAX_FREQUENCY << 8)){
+		return MAX_FREQUENCY;
+	}else{
+		return note >> 8;
+	}
+}
+/******************************************************************************
+ * BendPeriod(INT8U, INT16S) - Output period of a key bent by Offset, in
+ * SMCLK/4 ticks (see SynthPeriod()).
+ * The bent note is Key + Offset in 1/256 semitones; its period is
+ * interpolated linearly between the two PeriodTable entries around it
+ * (within 0.6 cents of the exact curve) by an 8 step shift-add multiply, so
+ * the cost is fixed and needs no division. Notes bent past either end of the
+ * table or next to a silent entry are silent.
+ *****************************************************************************/
+INT32U BendPeriod(INT8U Key, INT16S Offset){
+	INT16U note = ((INT16U)Key << 8) + Offset;	/*Wraps high below key 0*/
+	INT8U index;
+	INT8U fraction;
 	INT8U i;
-	for(i=0;i<NOTE_BUFF_LEN-1;i++){
-		if(NoteBuffer[i].KEY == DataBytes.KEY){
-			for(i;i<NOTE_BUFF_LEN-1;i++){
-				NoteBuffer[i] = NoteBuffer[i+1];
-			}
-			break;
+	INT32U low;
+	INT32U step;
+	INT32U delta = 0;
+
+	if(note > (MAX_FREQUENCY << 8)){
+		return 0;
+	}else{}
+	index = note >> 8;
+	fraction = note & 0xFF;
+	low = SynthPeriod(index);
+	if(fraction == 0){
+		return low;
+	}else if(low == 0 || PeriodTable[index + 1] == 0){
+		return 0;
+	}else{}
+	step = low - SynthPeriod(index + 1);
+	for(i=0;i<8;i++){							/*delta = step * fraction*/
+		if(fraction & 0x01){
+			delta += step << i;
 		}else{}
+		fraction >>= 1;
 	}
+	return low - (delta >> 8);
+}
+/******************************************************************************
+ * ChannelBend(INT8U) - A channel's pitch bend in 1/256 semitones. The full
+ * 14 bit bend off center is multiplied by BendRange with 32 bit shift-adds
+ * and only then shifted down by BEND_SHIFT, so every bend step counts at any
+ * range.
+ *****************************************************************************/
+INT16S ChannelBend(INT8U Channel){
+	INT32S step = BendValue[Channel];
+	INT32S offset = 0;
+	INT8U range = BendRange;
+	while(range){
+		if(range & 0x01){
+			offset += step;
+		}else{}
+		step += step;
+		range >>= 1;
+	}
+	return (INT16S)(offset >> BEND_SHIFT);
+}
+/******************************************************************************
+ * NoteOff() - Remove the key from the held note set if it is held on the
+ * message's channel.
+ *****************************************************************************/
+void NoteOff(void){
+	INT8U slot = FindNote(DataBytes.KEY);
+	if(slot != NO_NOTE){
+		ReleaseNote(slot);
+	}else{}
 }
 /******************************************************************************
  * NoteOn() - Checks if curent note on data has a velocity of zero; if so turn
- * off that note. Otherwise shift objects in note buffer over and set new note
- * as output.
+ * off that note. Otherwise make the key the most recent held note of its
+ * channel. When the pool is full the oldest held note is released to make
+ * room.
  *****************************************************************************/
 void NoteOn(void){
-	INT8U i;
+	INT8U slot;
+	INT8U key = DataBytes.KEY;
 	if(DataBytes.VELOCITY == 0){
 		NoteOff();
 	}else{
-		for(i=NOTE_BUFF_LEN-1;i>0;i--){
-			NoteBuffer[i] = NoteBuffer[i-1];
+		slot = FindNote(key);
+		if(slot != NO_NOTE){						/*Retrigger*/
+			UnlinkNote(slot);
+		}else{
+			if((NoteFree == NO_NOTE) && (NoteUsed >= NOTE_POOL_LEN)){
+				slot = NoteHead;
+				while(NEXT_NOTE(slot) != NO_NOTE){
+					slot = NEXT_NOTE(slot);
+				}
+				ReleaseNote(slot);					/*Evict oldest*/
+			}else{}
+			if(NoteFree != NO_NOTE){
+				slot = NoteFree;
+				NoteFree = NEXT_NOTE(slot);
+			}else{
+				slot = NoteUsed;
+				NoteUsed++;
+			}
+			NotePool[slot].Key = key;
 		}
-		NoteBuffer[OUTPUT] = DataBytes;
+		NotePool[slot].Velocity = DataBytes.VELOCITY;
+#if MIDI_LATENCY
+		LatencyPending = TRUE;
+#endif
+		NotePool[slot].Link = (RxChannel << 4) | NoteHead;	/*Link as most recent*/
+		NoteHead = slot;
 	}
 }
 /******************************************************************************
- * KeyPressure() - Scans the NoteBuffer and sets the active key velocity.
+ * MidiNote(INT8U, INT8U) - Plays a key through the NOTE_ON path as if it had
+ * been received on the basic channel; a Velocity of zero releases it. The
+ * data bytes of a message still being received are kept.
+ *****************************************************************************/
+void MidiNote(INT8U Key, INT8U Velocity){
+	MIDI_STRUCT received = DataBytes;
+	INT8U channel = RxChannel;
+	DataBytes.KEY = Key;
+	DataBytes.VELOCITY = Velocity;
+	RxChannel = MidiChannel;
+	NoteOn();
+#if MIDI_LATENCY
+	LatencyPending = FALSE;						/*Nothing was received*/
+#endif
+	UpdateSynth();
+	DataBytes = received;
+	RxChannel = channel;
+}
+/******************************************************************************
+ * KeyPressure() - Sets the velocity of a key held on the message's channel.
  *****************************************************************************/
 void KeyPressure(void){
-	INT8U i;
-	for(i=0;i<NOTE_BUFF_LEN;i++){
-		if(NoteBuffer[i].KEY == DataBytes.KEY){
-			NoteBuffer[i].VELOCITY = DataBytes.VELOCITY;
-			break;
+	INT8U slot = FindNote(DataBytes.KEY);
+	if(slot != NO_NOTE){
+		NotePool[slot].Velocity = DataBytes.VELOCITY;
+	}else{}
+}
+/******************************************************************************
+ * ChannelPressure() - Sets the velocity of every note held on the message's
+ * channel.
+ *****************************************************************************/
+void ChannelPressure(void){
+	INT8U slot = NoteHead;
+	while(slot != NO_NOTE){
+		if(NOTE_CHANNEL(slot) == RxChannel){
+			NotePool[slot].Velocity = DataBytes.Upper;
 		}else{}
+		slot = NEXT_NOTE(slot);
 	}
 }
 /******************************************************************************
- * ChannelPressure() - Changes the velocity the current output.
+ * NearestNote(INT8U, INT8U) - Pool slot of the most recent note of the
+ * highest key below Bound, or with Highest FALSE of the lowest key at or
+ * above it; NO_NOTE if there is none. Walks at most NOTE_POOL_LEN slots.
  *****************************************************************************/
-void ChannelPressure(void){
-	NoteBuffer[OUTPUT].VELOCITY = DataBytes.Upper;
+INT8U NearestNote(INT8U Bound, INT8U Highest){
+	INT8U slot = NoteHead;
+	INT8U best = NO_NOTE;
+	INT8U key;
+	while(slot != NO_NOTE){
+		key = NotePool[slot].Key;
+		if(Highest ? (key < Bound) : (key >= Bound)){
+			if((best == NO_NOTE) ||
+			   (Highest ? (key > NotePool[best].Key) : (key < NotePool[best].Key))){
+				best = slot;
+			}else{}
+		}else{}
+		slot = NEXT_NOTE(slot);
+	}
+	return best;
+}
+/******************************************************************************
+ * FindNote(INT8U) - Pool slot of a key held on RxChannel, NO_NOTE if it is
+ * not held there. Walks at most NOTE_POOL_LEN slots.
+ *****************************************************************************/
+INT8U FindNote(INT8U Key){
+	INT8U slot = NoteHead;
+	while((slot != NO_NOTE) &&
+		  ((NotePool[slot].Key != Key) || (NOTE_CHANNEL(slot) != RxChannel))){
+		slot = NEXT_NOTE(slot);
+	}
+	return slot;
+}
+/******************************************************************************
+ * ReleaseNote(INT8U) - Returns a held slot to the free list.
+ *****************************************************************************/
+void ReleaseNote(INT8U Slot){
+	UnlinkNote(Slot);
+	NotePool[Slot].Link = NoteFree;
+	NoteFree = Slot;
+}
+/******************************************************************************
+ * ReleaseChannel(INT8U) - Releases every note held on a channel.
+ *****************************************************************************/
+void ReleaseChannel(INT8U Channel){
+	INT8U slot = NoteHead;
+	INT8U next;
+	while(slot != NO_NOTE){
+		next = NEXT_NOTE(slot);
+		if(NOTE_CHANNEL(slot) == Channel){
+			ReleaseNote(slot);
+		}else{}
+		slot = next;
+	}
+}
+/******************************************************************************
+ * UnlinkNote(INT8U) - Remove a slot from the priority list. The list is only
+ * linked toward the oldest note, so the slot before it is found by walking
+ * from NoteHead.
+ *****************************************************************************/
+void UnlinkNote(INT8U Slot){
+	INT8U prev = NO_NOTE;
+	INT8U slot = NoteHead;
+	INT8U next = NEXT_NOTE(Slot);
+	while(slot != Slot){
+		prev = slot;
+		slot = NEXT_NOTE(slot);
+	}
+	if(prev != NO_NOTE){
+		NotePool[prev].Link = (NotePool[prev].Link & NOTE_CHANNEL_MASK) | next;
+	}else{
+		NoteHead = next;
+	}
+	if(OutputSlot == Slot){
+		OutputSlot = NO_NOTE;
+	}else{}
 }
 /******************************************************************************
- * PitchBend() - Builds and sets the Bend variable from the Midi data bytes.
+ * SelectNotes(INT8U *, INT8U) - Loads up to Max held note slots into Slots in
+ * NotePriority order and returns the count. Last note priority walks the list
+ * from the most recent note; highest and lowest take the most recent note of
+ * each key, stepping from key to key with NearestNote().
+ *****************************************************************************/
+INT8U SelectNotes(INT8U *Slots, INT8U Max){
+	INT8U count = 0;
+	INT8U slot;
+	INT8U high = (NotePriority == HIGHEST_NOTE_PRIORITY);
+	if(high || (NotePriority == LOWEST_NOTE_PRIORITY)){
+		slot = NearestNote(high ? MIDI_KEYS : 0, high);
+		while((slot != NO_NOTE)&&(count < Max)){
+			Slots[count++] = slot;
+			slot = NearestNote(high ? NotePool[slot].Key : NotePool[slot].Key + 1, high);
+		}
+	}else{
+		slot = NoteHead;
+		while((slot != NO_NOTE)&&(count < Max)){
+			Slots[count++] = slot;
+			slot = NEXT_NOTE(slot);
+		}
+	}
+	return count;
+}
+/******************************************************************************
+ * PitchBend() - Builds the 14 bit bend from the LSB (first data byte, in
+ * Upper) and MSB (Lower) and keeps it for the message's channel.
  *****************************************************************************/
 void PitchBend(void){
-	Bend = (DataBytes.Lower << 7)| DataBytes.Upper; /*Build 14 bit word*/
+	INT16U bend = (DataBytes.Lower << 7)| DataBytes.Upper; /*Build 14 bit word*/
+	BendValue[RxChannel] = (INT16S)(bend - BEND_CENTER);
 }
 /******************************************************************************
- * ProcessMidiData() - A switch statement that calls the appropriate function
- * to process the MIDI data bytes based off the current status.
+ * ProcessMidiData(INT8U, const MIDI_HANDLER *) - Calls the handler of a
+ * completed message and updates the output if the message changes it.
+ * Message is its status byte, traced with the first data byte; SysEx data
+ * bytes and Timing Clocks are left out of the trace.
  *****************************************************************************/
-void ProcessMidiData(void){
-	switch(Status){
-	case NOTE_OFF:
-		NoteOff();
-		UpdateSynth();
+void ProcessMidiData(INT8U Message, const MIDI_HANDLER *Entry){
+#if TRACE
+	if((Message != SYSTEM_EXCLUSIVE) && (Message != TIMING_TICK)){
+		TraceLog(Message, DataBytes.Upper);
+	}else{}
+#endif
+	if(Entry->Handler){
+		Entry->Handler();
+		if(Entry->Update){
+			UpdateSynth();
+		}else{}
+	}else{}
+}
+/******************************************************************************
+ * MidiSetOmni(INT8U) - Plays every channel, or only the basic channel.
+ *****************************************************************************/
+void MidiSetOmni(INT8U Omni){
+	ChannelMask = Omni ? OMNI_CHANNELS : ChannelBits[MidiChannel];
+}
+/******************************************************************************
+ * ClearNoteBuffer() - Release every held note. Only the list heads are reset;
+ * pool slots are only read once linked again.
+ *****************************************************************************/
+void ClearNoteBuffer(void){
+	NoteHead = NO_NOTE;
+	NoteFree = NO_NOTE;
+	NoteUsed = 0;
+	OutputSlot = NO_NOTE;
+}
+/******************************************************************************
+ * MIDI_RX() - USCI A0 Interrupt, called when the Rx buffer is full.
+ * Queues the received byte for THRU, pushes it into the receive FIFO and posts
+ * EVENT_MIDI_RX. A full FIFO drops the byte and counts the overflow. Timing
+ * Clocks are stamped on arrival for ClockTick(), which runs when the byte is
+ * parsed, so the interrupt stays short.
+ *****************************************************************************/
+#pragma vector=USCIAB0RX_VECTOR
+__interrupt void MIDI_RX(void){
+	INT8U byte;
+	INT8U head;
+	INT8U level;
+	INT32U stamp = 0;
+	byte = UCA0RXBUF;
+	if(byte == TIMING_TICK){
+		stamp = GetTime();
+	}else{}
+	ThruByte(byte);
+#if TRACE
+    if((byte & STATUS_BIT) && (byte != TIMING_TICK)){
+    	TraceLog(TRACE_RX_STATUS, byte);
+    }else{}
+#endif
+    head = (MidiRxHead + 1) & MIDI_RX_BUFF_MASK;
+    if(head != MidiRxTail){
+    	MidiRxBuffer[MidiRxHead] = byte;
+#if MIDI_LATENCY
+    	MidiRxStamp[MidiRxHead] = (INT16U)(GetTime() >> LATENCY_SHIFT);
+#endif
+    	MidiRxHead = head;
+    	if(byte == TIMING_TICK){
+    		ClockArrived(stamp);
+    	}else{}
+    	level = (head - MidiRxTail) & MIDI_RX_BUFF_MASK;
+    	if(level > MidiRxHighWater){
+    		MidiRxHighWater = level;
+    	}else{}
+    }else{
+    	MidiRxOverflows++;
+    	TRACE_EVENT(TRACE_RX_DROP, byte);
+    }
+    KernelEvents |= EVENT_MIDI_RX;
+    __bic_SR_register_on_exit(LPM0_bits);	/*Wake the kernel*/
+}
+/******************************************************************************
+ * ControllerChange() - Handles the channel mode controllers and the pitch
+ * bend sensitivity registered parameter. Poly and mono mode on select the
+ * output scheduler and release all held notes; omni on and off are only
+ * taken on the basic channel. CHANNEL_ENABLE_CTL adds or drops the channel
+ * it is sent on; the basic channel is always played.
+ *****************************************************************************/
+void ControllerChange(void){
+	switch(DataBytes.Upper){
+	case CHANNEL_ENABLE_CTL:
+		if(RxChannel == MidiChannel){
+		}else if(DataBytes.Lower >= CONTROLLER_SWITCH_ON){
+			ChannelMask |= ChannelBits[RxChannel];
+		}else{
+			ChannelMask &= ~ChannelBits[RxChannel];
+			ReleaseChannel(RxChannel);
+			BendValue[RxChannel] = 0;
+			UpdateSynth();
+		}
 		break;
-	case NOTE_ON:
-		NoteOn();
-		UpdateSynth();
+	case OMNI_MODE_OFF:
+	case OMNI_MODE_ON:
+		if(RxChannel == MidiChannel){
+			MidiSetOmni(DataBytes.Upper == OMNI_MODE_ON);
+			ClearNoteBuffer();
+			UpdateSynth();
+		}else{}
 		break;
-	case KEY_PRESSURE:
-		KeyPressure();
-		UpdateSynth();
+	case RPN_MSB:
+		RpnMsb = DataBytes.Lower;
 		break;
-	case CONTROLLER_CHANGE:
-		ControllerChange();
+	case RPN_LSB:
+		RpnLsb = DataBytes.Lower;
 		break;
-	case PROGRAM_CHANGE:
-		ProgramChange();
+	case NRPN_MSB:								/*Not supported, deselect*/
+	case NRPN_LSB:
+		RpnMsb = RPN_NULL;
+		RpnLsb = RPN_NULL;
 		break;
-	case CHANNEL_PRESSURE:
-		ChannelPressure();
-		UpdateSynth();
+	case DATA_ENTRY:
+		if(RpnMsb == 0 && RpnLsb == RPN_BEND_RANGE){
+			BendRange = (DataBytes.Lower > BEND_RANGE_MAX) ? BEND_RANGE_MAX : DataBytes.Lower;
+			UpdateSynth();
+		}else{}
 		break;
-	case PITCH_BEND:
-		PitchBend();
+	case MONO_MODE_ON:
+		Polyphony = FALSE;
+		ClearNoteBuffer();
 		UpdateSynth();
 		break;
-	case SYSTEM_EXCLUSIVE:
-		SystemExclusive();
-		break;
-	case SONG_POSITION:
-		SongPosition();
-		break;
-	case SONG_SELECT:
-		SongSelect();
-		break;
-	case BUS_SELECT:
-		BusSelect();
+	case GATE_DIVISION_CTL:
+		ClockSetDivision(DataBytes.Lower);
 		break;
-	case TUNE_REQUEST:
-		TuneRequest();
+	case GATE_LENGTH_CTL:
+		ClockSetLength(DataBytes.Lower);
 		break;
-	case END_OF_SYSTEM_EXCLUSIVE:
-		EndOfSystemExclusive();
+	case BURST_ON_CTL:
+		BurstSetOn(DataBytes.Lower);
 		break;
-	case TIMING_TICK:
-		TimingTick();
+	case BURST_OFF_CTL:
+		BurstSetOff(DataBytes.Lower);
 		break;
-	case START_SONG:
-		StartSong();
-		break;
-	case CONTINUE_SONG:
-		ContinueSong();
-		break;
-	case STOP_SONG:
-		StopSong();
-		break;
-	case ACTIVE_SENSING:
-		ActiveSensing();
-		break;
-	case SYSTEM_RESET:
-		SystemReset();
+	case POLY_MODE_ON:
+		Polyphony = TRUE;
+		ClearNoteBuffer();
+		UpdateSynth();
 		break;
 	default:
 		break;
 	}
 }
+#if MIDI_LATENCY
 /******************************************************************************
- * ClearNoteBuffer()
+ * RecordLatency(INT16U) - Counts a NOTE_ON to output latency in its log2
+ * bucket: bucket 0 is 0 us, bucket n holds 2^(n-1) to 2^n - 1 us and the last
+ * bucket everything longer.
  *****************************************************************************/
-void ClearNoteBuffer(void){
+void RecordLatency(INT16U Latency){
+	INT8U bucket = 0;
+	INT16U us = Latency;
+	while(us && bucket < (LATENCY_BUCKETS - 1)){
+		us >>= 1;
+		bucket++;
+	}
+	if(LatencyHist[bucket] != 0xFFFF){
+		LatencyHist[bucket]++;
+	}else{}
+	if(Latency > LatencyMax){
+		LatencyMax = Latency;
+	}else{}
+}
+/******************************************************************************
+ * ResetLatency() - Clears the latency histogram.
+ *****************************************************************************/
+void ResetLatency(void){
 	INT8U i;
-	for(i=NOTE_BUFF_LEN-1;i>0;i--){
-		NoteBuffer[i] = EmptyStruct;
+	for(i=0;i<LATENCY_BUCKETS;i++){
+		LatencyHist[i] = 0;
 	}
+	LatencyMax = 0;
 }
+#endif
 /******************************************************************************
- * MIDI_RX() - USCI A0 Interrupt, called when the Rx buffer is full.
- * Relays the received byte over Tx loads byte into global and sets ready flag.
+ * MidiTx(INT8U) - Queues a byte for MIDI out, waiting while the TX ring is
+ * full. Queue whole messages under MidiTxHold() so no THRU byte falls inside
+ * them.
  *****************************************************************************/
-#pragma vector=USCIAB0RX_VECTOR
-__interrupt void MIDI_RX(void){
-	while (!(IFG2&UCA0TXIFG)){};
-    UCA0TXBUF  = UCA0RXBUF;
-    MidiByte   = UCA0RXBUF;
-    MidiRxFlag = TRUE;
+void MidiTx(INT8U Byte){
+	unsigned short state;
+	INT8U queued;
+	do{
+		state = __get_interrupt_state();
+		__disable_interrupt();
+		queued = TxPush(Byte);
+		__set_interrupt_state(state);
+	}while(!queued);
+}
+/******************************************************************************
+ * MidiTxHold(INT8U) - TRUE holds THRU back while a reply is queued, FALSE
+ * releases it. Real-time bytes still go through, as MIDI allows them inside
+ * any message. A hold waits for a MidiTxStream() reply to finish first.
+ *****************************************************************************/
+void MidiTxHold(INT8U Hold){
+	unsigned short state;
+	INT8U busy;
+	do{
+		state = __get_interrupt_state();
+		__disable_interrupt();
+		busy = Hold && TxSource;
+		if(!busy){
+			ThruHold = Hold;
+		}else{}
+		__set_interrupt_state(state);
+	}while(busy);
+}
+/******************************************************************************
+ * MidiTxStream(INT8U (*)(INT8U *)) - Ends a reply queued under MidiTxHold()
+ * with bytes from Source, which MIDI_TX() calls for the next byte whenever
+ * the ring is empty until it returns FALSE. For replies longer than the
+ * ring, so the main loop does not wait on MIDI out. THRU stays held until
+ * the stream ends. Source runs in the interrupt.
+ *****************************************************************************/
+void MidiTxStream(INT8U (*Source)(INT8U *Byte)){
+	unsigned short state = __get_interrupt_state();
+	__disable_interrupt();
+	TxSource = Source;
+	IE2 |= UCA0TXIE;
+	__set_interrupt_state(state);
+}
+/******************************************************************************
+ * ThruByte(INT8U) - Relays a received byte to MIDI out through ThruFilter.
+ * A small parser follows the input's running status and message lengths so
+ * the data bytes of a filtered message are dropped with it. A message that
+ * overlaps a MidiTxHold() is dropped whole, as is the F7 of such a SysEx;
+ * relaying resumes with the next message. With THRU_RUNNING_STATUS a channel
+ * status equal to the last one sent is left out, and a status cancelled on
+ * MIDI out by a queued SysEx is sent again. Called from MIDI_RX(); a full TX
+ * ring drops the byte.
+ *****************************************************************************/
+void ThruByte(INT8U Byte){
+	if(Byte >= TIMING_TICK){						/*Real-time*/
+		if((Byte == ACTIVE_SENSING) && (ThruFilter & THRU_NO_SENSING)){
+			return;
+		}else{}
+	}else if(Byte & STATUS_BIT){
+		ThruStatus = Byte;
+		ThruLeft = ThruLength(Byte);
+		ThruSkip = ThruHold || (ThruSkip && (Byte == END_OF_SYSTEM_EXCLUSIVE));
+		ThruDrop = (Byte < SYSTEM_EXCLUSIVE) && (ThruFilter & THRU_OTHER_CHANNELS) &&
+				   (ChannelMask & ChannelBits[Byte & CHANNEL_MASK]);
+		if(ThruDrop || ThruSkip || ((Byte == TxRunning) && (ThruFilter & THRU_RUNNING_STATUS))){
+			return;
+		}else{}
+	}else if(ThruStatus == NO_STATUS){
+		return;
+	}else{
+		if(ThruLeft == 0){							/*Next message, running status*/
+			ThruLeft = ThruLength(ThruStatus);
+			ThruSkip = FALSE;
+		}else{}
+		if((ThruLeft != 0) && (ThruStatus != SYSTEM_EXCLUSIVE)){
+			ThruLeft--;
+		}else{}
+		ThruSkip |= ThruHold;
+		if(ThruDrop || ThruSkip){
+			return;
+		}else if((ThruStatus < SYSTEM_EXCLUSIVE) && (ThruStatus != TxRunning)){
+			if(!TxPush(ThruStatus)){				/*Cancelled by a queued message*/
+				MidiTxOverflows++;
+				return;
+			}else{}
+		}else{}
+	}
+	if(!TxPush(Byte)){
+		MidiTxOverflows++;
+	}else{}
+}
+/******************************************************************************
+ * ThruLength(INT8U) - Data bytes in a message with the given status; a SysEx
+ * counts as one per byte.
+ *****************************************************************************/
+INT8U ThruLength(INT8U Status){
+	if(Status < SYSTEM_EXCLUSIVE){
+		return ChannelHandlers[Status >> 4].Length;
+	}else{
+		return SystemHandlers[Status & CHANNEL_MASK].Length;
+	}
+}
+/******************************************************************************
+ * TxPush(INT8U) - Appends a byte to the TX ring and enables the TX interrupt.
+ * Returns FALSE if the ring is full. Tracks the running status of MIDI out:
+ * system common messages cancel it, real-time messages leave it. Called with
+ * interrupts disabled.
+ *****************************************************************************/
+INT8U TxPush(INT8U Byte){
+	INT8U head = (MidiTxHead + 1) & MIDI_TX_BUFF_MASK;
+	if(head == MidiTxTail){
+		return FALSE;
+	}else{}
+	MidiTxBuffer[MidiTxHead] = Byte;
+	MidiTxHead = head;
+	if(Byte >= TIMING_TICK){
+	}else if(Byte >= SYSTEM_EXCLUSIVE){
+		TxRunning = NO_STATUS;
+	}else if(Byte & STATUS_BIT){
+		TxRunning = Byte;
+	}else{}
+	IE2 |= UCA0TXIE;
+	return TRUE;
+}
+/******************************************************************************
+ * MIDI_TX() - USCI A0/B0 Tx Interrupt, called when the A0 Tx buffer is empty
+ * and bytes are queued. Sends the next byte from the TX ring, or once it is
+ * empty from the stream of MidiTxStream(); when both are done the interrupt
+ * is disabled and THRU released. USCI B0 (the LCD) is polled and never
+ * interrupts.
+ *****************************************************************************/
+#pragma vector=USCIAB0TX_VECTOR
+__interrupt void MIDI_TX(void){
+	INT8U tail = MidiTxTail;
+	INT8U byte;
+	if(tail != MidiTxHead){
+		UCA0TXBUF = MidiTxBuffer[tail];
+		MidiTxTail = (tail + 1) & MIDI_TX_BUFF_MASK;
+	}else if(TxSource && TxSource(&byte)){
+		UCA0TXBUF = byte;
+	}else{
+		if(TxSource){
+			TxSource = 0;
+			ThruHold = FALSE;
+		}else{}
+		IE2 &= ~UCA0TXIE;
+	}
+}
+/******************************************************************************
+ * SystemExclusive() - Called with each SysEx data byte in DataBytes.Upper.
+ *****************************************************************************/
+void SystemExclusive(void){
+	SysExByte(DataBytes.Upper);
+}
+/******************************************************************************
+ * SongPosition() - Moves the clock position; the pointer counts sixteenth
+ * notes, LSB first.
+ *****************************************************************************/
+void SongPosition(void){
+	ClockLocate(((INT16U)DataBytes.Lower << 7) | DataBytes.Upper);
+}
+/******************************************************************************
+ * SongSelect() - Cues the stored song numbered DataBytes.Upper.
+ *****************************************************************************/
+void SongSelect(void){
+	SongCue(DataBytes.Upper);
+}
+/******************************************************************************
+ * EndOfSystemExclusive() - The SysEx message is complete.
+ *****************************************************************************/
+void EndOfSystemExclusive(void){
+	SysExEnd();
+}
+/******************************************************************************
+ * TimingTick() - Passes a Timing Clock to the tempo tracker and the gate.
+ *****************************************************************************/
+void TimingTick(void){
+	ClockTick();
+}
+/******************************************************************************
+ * StartSong(), StopSong(), ContinueSong() - Transport for the song player
+ * and the tempo gate.
+ *****************************************************************************/
+void StartSong(void){
+	SongStart();
+	ClockStart();
+}
+void StopSong(void){
+	SongStop();
+	ClockStop();
+}
+void ContinueSong(void){
+	SongContinue();
+	ClockContinue();
 }
 /*Unused Midi functions, included for portability*/
-void ControllerChange(void){}
 void ProgramChange(void){}
-void SystemExclusive(void){}
-void SongPosition(void){}
-void SongSelect(void){}
 void BusSelect(void){}
 void TuneRequest(void){}
-void EndOfSystemExclusive(void){}
-void TimingTick(void){}
-void StartSong(void){}
 void ActiveSensing(void){}
 void SystemReset(void){}
-void StopSong(void){}
-void ContinueSong(void){}
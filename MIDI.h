@@ -12,36 +12,58 @@
 static void NoteOff(void);
 static void NoteOn(void);
 static void KeyPressure(void);
-static void ControllerChange(void);  	//Not Implemented
+static void ControllerChange(void);
 static void ProgramChange(void);		//Not Implemented
 static void ChannelPressure(void);
 static void PitchBend(void);
-static void SystemExclusive(void);		//Not Implemented
-static void SongPosition(void);			//Not Implemented
-static void SongSelect(void);			//Not Implemented
+static void SystemExclusive(void);
+static void SongPosition(void);
+static void SongSelect(void);
 static void BusSelect(void);			//Not Implemented
 static void TuneRequest(void);			//Not Implemented
-static void EndOfSystemExclusive(void);	//Not Implemented
-static void TimingTick(void);			//Not Implemented
-static void StartSong(void);			//Not Implemented
+static void EndOfSystemExclusive(void);
+static void TimingTick(void);
+static void StartSong(void);
 static void ActiveSensing(void);		//Not Implemented
 static void SystemReset(void);			//Not Implemented
-static void StopSong(void);				//Not Implemented
-static void ContinueSong(void);			//Not Implemented
+static void StopSong(void);
+static void ContinueSong(void);
 
 /*Midi Processing Functions*/
+static void ParseMidiByte(INT8U MidiByte);
 static void UpdateSynth(void);
-static void ProcessMidiData(void);
+static INT8U BendKey(INT8U Key, INT16S Offset);
+static INT32U BendPeriod(INT8U Key, INT16S Offset);
+static INT16S ChannelBend(INT8U Channel);
+
+/*Held Note Set Functions*/
+static INT8U NearestNote(INT8U Bound, INT8U Highest);
+static INT8U FindNote(INT8U Key);
+static void ReleaseNote(INT8U Slot);
+static void ReleaseChannel(INT8U Channel);
+static void UnlinkNote(INT8U Slot);
+static INT8U SelectNotes(INT8U *Slots, INT8U Max);
+static void ProcessMidiData(INT8U Message, const MIDI_HANDLER *Entry);
+static void RecordLatency(INT16U Latency);
+static void ThruByte(INT8U Byte);
+static INT8U ThruLength(INT8U Status);
+static INT8U TxPush(INT8U Byte);
 /******************************************************************************
  * Public Functions
  *****************************************************************************/
 void ClearNoteBuffer(void);
 void HandleMidiFrameTask(void);
+void MidiTx(INT8U Byte);
+void MidiTxHold(INT8U Hold);
+void MidiTxStream(INT8U (*Source)(INT8U *Byte));
+void MidiNote(INT8U Key, INT8U Velocity);
+void MidiSetOmni(INT8U Omni);
+void ResetLatency(void);
 /******************************************************************************
  * Defines
  *****************************************************************************/
 /*MIDI Constants*/
-#define CONTROLLER_CHANNEL 		0x00 /*Change from 0x0 through 0xF to set MIDI channel*/
+#define CONTROLLER_CHANNEL 		0x00 /*Default basic channel, 0x0 through 0xF; see Store.c*/
 #define NOTE_OFF				(0x80 | CONTROLLER_CHANNEL)
 #define NOTE_ON					(0x90 | CONTROLLER_CHANNEL)
 #define KEY_PRESSURE			(0xA0 | CONTROLLER_CHANNEL)
@@ -62,17 +84,71 @@ void HandleMidiFrameTask(void);
 #define ACTIVE_SENSING			0xFE
 #define SYSTEM_RESET			0xFF
 #define BEND_CENTER		   		0x2000
+#define CHANNEL_MASK			0x0F
+#define DATA_ENTRY				6	/*Controller numbers*/
+#define GATE_DIVISION_CTL		16	/*General purpose 1, see Clock.c*/
+#define GATE_LENGTH_CTL			17	/*General purpose 2*/
+#define BURST_ON_CTL			18	/*General purpose 3, see Burst.c*/
+#define BURST_OFF_CTL			19	/*General purpose 4*/
+#define CHANNEL_ENABLE_CTL		80	/*General purpose 5, a switch*/
+#define NRPN_LSB				98
+#define NRPN_MSB				99
+#define RPN_LSB					100
+#define RPN_MSB					101
+#define OMNI_MODE_OFF			124
+#define OMNI_MODE_ON			125
+#define MONO_MODE_ON			126
+#define POLY_MODE_ON			127
+#define CONTROLLER_SWITCH_ON	64	/*Switch controllers are on from this value*/
+#define NO_STATUS				0x00
+#define RPN_NULL				0x7F
+#define RPN_BEND_RANGE			0x00	/*Pitch bend sensitivity, RPN 0/0*/
 
 /*MIDI Module Defines*/
-#define NOTE_BUFF_LEN  12
-#define UPPER 		   1
-#define LOWER          0
+#define MIDI_KEYS      128
+#define MIDI_CHANNELS  16
+#define OMNI_CHANNELS  0xFFFF	/*ChannelMask in omni mode*/
+#define OMNI_MODE      FALSE	/*Default; see Store.c*/
+#define NOTE_POOL_LEN  12		/*Held notes, at most 15; key lookups walk at most this many*/
+#define NO_NOTE        0x0F		/*Fits the slot nibble of a link*/
+#define NOTE_NEXT_MASK 0x0F		/*NOTE_NODE Link bits*/
+#define NOTE_CHANNEL_MASK 0xF0
+#define NEXT_NOTE(Slot)    (NotePool[Slot].Link & NOTE_NEXT_MASK)
+#define NOTE_CHANNEL(Slot) (NotePool[Slot].Link >> 4)
+#define LAST_NOTE_PRIORITY    0
+#define HIGHEST_NOTE_PRIORITY 1
+#define LOWEST_NOTE_PRIORITY  2
+#define NOTE_PRIORITY  LAST_NOTE_PRIORITY	/*Default note priority*/
 #define KEY 	       Upper	/*DataByte assignments*/
 #define VELOCITY       Lower
-#define OUTPUT 		   0		/*Index 0*/
+#define OUTPUT 		   0		/*Voice of the selected note*/
 #define STATUS_BIT	   0x80
 #define MAX_FREQUENCY  127
 #define MAX_ONTIME     127
+#define BEND_RANGE     2		/*Default pitch bend range in semitones*/
+#define BEND_RANGE_MAX 24
+#define BEND_SHIFT     5		/*Bend off center times range to 1/256 semitones*/
+#define NOTE_WRAPPED   0xC000	/*Bent note indexes this high are below key 0*/
+
+/*MIDI Receive FIFO Defines*/
+#define MIDI_RX_BUFF_LEN  16		/*Must be a power of two; ~5 ms at 31250 baud*/
+#define MIDI_RX_BUFF_MASK (MIDI_RX_BUFF_LEN - 1)
+
+/*MIDI THRU Defines*/
+#define MIDI_TX_BUFF_LEN  16		/*Must be a power of two*/
+#define MIDI_TX_BUFF_MASK (MIDI_TX_BUFF_LEN - 1)
+#define THRU_RUNNING_STATUS 0x01	/*ThruFilter bits*/
+#define THRU_NO_SENSING     0x02	/*Drop active sensing*/
+#define THRU_OTHER_CHANNELS 0x04	/*Drop messages on the channels played*/
+#define THRU_FILTER_ALL     0x07
+#define THRU_FILTER         THRU_RUNNING_STATUS		/*Default*/
+
+/*Latency Histogram Defines*/
+#ifndef MIDI_LATENCY
+#define MIDI_LATENCY      0			/*1 keeps the timestamps and histogram (101 bytes of RAM)*/
+#endif
+#define LATENCY_BUCKETS   16
+#define LATENCY_SHIFT     4			/*GetTime() ticks to us*/
 
 
 
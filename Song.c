@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Song.c - Plays pre-compiled songs from flash without a MIDI source. Each
+ * event is one 16 bit word read in place from SongTable:
+ *
+ *   key(7) | velocity(4) | delta(5)
+ *
+ * The delta counts slices (10.24 ms) from the previous event. A velocity of
+ * zero releases the key; key 0 with velocity 0 is a rest, used for gaps longer
+ * than 31 slices. SONG_END closes a song. Notes go through MidiNote(), the
+ * same held note set a received NOTE_ON uses. sim/mid2song converts Standard
+ * MIDI Files.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+#include "Song.h"
+
+static const INT16U *SongPtr = 0;	/*Next event; 0 until a song is cued*/
+static INT8U SongIndex = 0;
+static INT8U SongWait = 0;			/*Slices before the event at SongPtr*/
+static INT8U Playing = FALSE;
+
+extern INT8U Mode;
+
+/******************************************************************************
+ * SongTask() - Counts down to the next event and plays every event that is
+ * due. Runs every slice; stops at SONG_END or when Manual mode is entered.
+ *****************************************************************************/
+void SongTask(void){
+	if(Playing && (Mode != MIDI_MODE)){
+		Playing = FALSE;
+	}else{}
+	if(Playing){
+		if(SongWait){
+			SongWait--;
+		}else{}
+		while(Playing && (SongWait == 0)){
+			if(*SongPtr == SONG_END){
+				SongStop();
+			}else{
+				PlayEvent(*SongPtr);
+				SongPtr++;
+				SongWait = SONG_DELTA(*SongPtr);
+			}
+		}
+	}else{}
+}
+/******************************************************************************
+ * SongStart() - Play the cued song from its beginning.
+ *****************************************************************************/
+void SongStart(void){
+	SongCue(SongIndex);
+	SongContinue();
+}
+/******************************************************************************
+ * SongStop() - Pause the player and silence the output. Notes still held
+ * from MIDI input are released as well.
+ *****************************************************************************/
+void SongStop(void){
+	if(Playing){
+		Playing = FALSE;
+		ClearNoteBuffer();
+		SynthStop();
+	}else{}
+}
+/******************************************************************************
+ * SongContinue() - Resume from the current position; notes that were held
+ * when the song stopped stay released.
+ *****************************************************************************/
+void SongContinue(void){
+	if((Mode == MIDI_MODE) && SongPtr && (*SongPtr != SONG_END)){
+		Playing = TRUE;
+	}else{}
+}
+/******************************************************************************
+ * SongCue(INT8U) - Stop and rewind to the start of a song. Out of range song
+ * numbers are ignored.
+ *****************************************************************************/
+void SongCue(INT8U Song){
+	if(Song < SongCount){
+		SongStop();
+		SongIndex = Song;
+		SongPtr = SongTable[Song];
+		SongWait = SONG_DELTA(*SongPtr);
+	}else{}
+}
+/******************************************************************************
+ * SongToggle() - Start the cued song, or stop the one playing.
+ *****************************************************************************/
+void SongToggle(void){
+	if(Playing){
+		SongStop();
+	}else{
+		SongStart();
+	}
+}
+/******************************************************************************
+ * PlayEvent(INT16U) - Hand one event to the note path.
+ *****************************************************************************/
+void PlayEvent(INT16U Event){
+	INT8U velocity = SONG_VELOCITY(Event);
+	if(SONG_KEY(Event)){
+		MidiNote(SONG_KEY(Event), (velocity << SONG_VEL_SHIFT) | (velocity >> 1));
+	}else{}											/*Rest*/
+}
@@ -0,0 +1,27 @@
+/******************************************************************************
+ * Song.h - Header for the Song.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Private Functions
+ *****************************************************************************/
+static void PlayEvent(INT16U Event);
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void SongTask(void);
+void SongStart(void);
+void SongStop(void);
+void SongContinue(void);
+void SongCue(INT8U Song);
+void SongToggle(void);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+/*Event word: key(15..9) velocity(8..5) delta(4..0); see sim/mid2song.c*/
+#define SONG_KEY(e)       ((INT8U)((e) >> 9))
+#define SONG_VELOCITY(e)  ((INT8U)(((e) >> 5) & 0x0F))
+#define SONG_DELTA(e)     ((INT8U)((e) & 0x1F))
+#define SONG_END          0x0000	/*Rests always have a delta, so never 0x0000*/
+#define SONG_VEL_SHIFT    3			/*4 bit velocity to MIDI velocity*/
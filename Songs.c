@@ -0,0 +1,28 @@
+/******************************************************************************
+ * Songs.c - Songs stored in flash for the player in Song.c. New songs are
+ * made with sim/mid2song and added to SongTable; see Song.c for the format.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+
+/*Generated by sim/mid2song from ode.mid, 94 events*/
+const INT16U OdeToJoy[] = {
+	0x8180, 0x001F, 0x8016, 0x8186, 0x001F, 0x8015, 0x8386, 0x001F,
+	0x8216, 0x8786, 0x001F, 0x8616, 0x8785, 0x001F, 0x8616, 0x8386,
+	0x001F, 0x8216, 0x8186, 0x001F, 0x8015, 0x7D86, 0x001F, 0x7C16,
+	0x7986, 0x001F, 0x7815, 0x7986, 0x001F, 0x7816, 0x7D86, 0x001F,
+	0x7C16, 0x8186, 0x001F, 0x8015, 0x8186, 0x001F, 0x001F, 0x8011,
+	0x7D89, 0x7C1A, 0x7D83, 0x001F, 0x001F, 0x001F, 0x7C0D, 0x818C,
+	0x001F, 0x8015, 0x8186, 0x001F, 0x8016, 0x8386, 0x001F, 0x8215,
+	0x8786, 0x001F, 0x8616, 0x8786, 0x001F, 0x8616, 0x8385, 0x001F,
+	0x8216, 0x8186, 0x001F, 0x8016, 0x7D86, 0x001F, 0x7C15, 0x7986,
+	0x001F, 0x7816, 0x7986, 0x001F, 0x7816, 0x7D85, 0x001F, 0x7C16,
+	0x8186, 0x001F, 0x8016, 0x7D86, 0x001F, 0x001F, 0x7C11, 0x7989,
+	0x781A, 0x7983, 0x001F, 0x001F, 0x001F, 0x780C, SONG_END
+};
+
+const INT16U *const SongTable[] = {
+	OdeToJoy
+};
+const INT8U SongCount = sizeof(SongTable) / sizeof(SongTable[0]);
@@ -0,0 +1,257 @@
+/******************************************************************************
+ * Store.c - Tables and parameters uploaded over SysEx into main flash. Two
+ * segments hold one image each; an upload always goes to the segment that is
+ * not in use, so a failed or interrupted upload leaves the last image intact:
+ *
+ *   BEGIN   erase the spare segment
+ *   BLOCK   one STORE_BLOCK_LEN block of the body, 7 bit packed with a CRC;
+ *           unpacked over the message, checked, programmed and read back
+ *   COMMIT  fill the blocks not sent (and erased parameter bytes) from the
+ *           image in use, then write the header with the magic last
+ *
+ * At reset the newest image with a good magic and CRC is used; without one
+ * the tables compiled into main.c are. PeriodTable and OnTimeTable point
+ * into the image, so the tables are read in place from flash.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include <stddef.h>
+#include "includes.h"
+#include "Store.h"
+
+const INT16U *PeriodTable = PeriodLookup;
+const INT8U *OnTimeTable = OnTimeLookup;
+static const STORE_IMAGE *Active = 0;	/*Image in use, 0 for the defaults*/
+static STORE_IMAGE *Target = 0;			/*Segment being uploaded, 0 if none*/
+static INT32U Written;					/*Blocks of Target programmed*/
+
+#ifdef STORE_FLASH
+/*The two segments, placed by the linker like any other constant so it fails
+  on an overlap with code. Only the first byte is initialized; the image is
+  invalid until an upload, and BEGIN erases a segment before writing it.
+  Volatile as the contents change behind the compiler's back.*/
+#pragma DATA_ALIGN(StoreFlash, FLASH_SEG_LEN)
+static const volatile INT8U StoreFlash[STORE_SEGMENTS][FLASH_SEG_LEN] = {{STORE_ERASED}};
+#endif
+
+static const STORE_PARAMS DefaultParams = {
+	CONTROLLER_CHANNEL, BEND_RANGE, NOTE_PRIORITY, DUTY_CEILING_PCT, THRU_FILTER,
+	OMNI_MODE,
+	{STORE_ERASED, STORE_ERASED, STORE_ERASED, STORE_ERASED,
+	 STORE_ERASED, STORE_ERASED, STORE_ERASED, STORE_ERASED,
+	 STORE_ERASED, STORE_ERASED}
+};
+
+extern INT8U MidiChannel;
+extern INT8U BendRange;
+extern INT8U NotePriority;
+extern INT8U ThruFilter;
+
+/******************************************************************************
+ * StoreInit() - Select the newest valid image and apply it.
+ *****************************************************************************/
+void StoreInit(void){
+	INT8U i;
+	const STORE_IMAGE *image;
+	FCTL2 = FLASH_CLOCK;
+	Active = 0;
+	for(i=0;i<STORE_SEGMENTS;i++){
+		image = (const STORE_IMAGE *)FLASH_SEGMENT(i);
+		if(ImageValid(image)){
+			if(!Active || ((INT16S)(image->Sequence - Active->Sequence) > 0)){
+				Active = image;
+			}else{}
+		}else{}
+	}
+	StoreApply();
+}
+/******************************************************************************
+ * StoreBegin() - Silence the output and erase the spare segment. The erase
+ * holds the CPU for about 12 ms, so the sender must wait for the reply.
+ *****************************************************************************/
+INT8U StoreBegin(void){
+	ClearNoteBuffer();
+	SynthStop();
+	if(Active == (const STORE_IMAGE *)FLASH_SEGMENT(0)){
+		Target = (STORE_IMAGE *)FLASH_SEGMENT(1);
+	}else{
+		Target = (STORE_IMAGE *)FLASH_SEGMENT(0);
+	}
+	FlashErase((INT8U *)Target);
+	Written = 0;
+	return STORE_OK;
+}
+/******************************************************************************
+ * StoreBlock(INT8U *, INT8U) - Data is the block number, the packed block
+ * and its CRC as three 7 bit bytes. Each group of up to 7 bytes is preceded
+ * by a byte holding their top bits, bit 0 for the first. The block is
+ * unpacked in place; each byte lands before the packed bytes still unread.
+ *****************************************************************************/
+INT8U StoreBlock(INT8U *Data, INT8U Len){
+	INT8U block = Data[0];
+	INT8U i;
+	INT8U n = 0;
+	INT8U msbs = 0;
+	INT16U crc;
+	INT8U *stage;
+	INT8U *dest;
+	if(!Target){
+		return STORE_NOT_OPEN;
+	}else if((Len != STORE_MSG_LEN)||(block >= STORE_BLOCKS)||
+			 (Written & ((INT32U)1 << block))){
+		return STORE_BAD_BLOCK;
+	}else{}
+	Data++;
+	stage = Data;
+	for(i=0;i<STORE_PACKED_LEN;i++){			/*Unpack over the message*/
+		if((i & 0x07) == 0){
+			msbs = Data[i];
+		}else{
+			stage[n++] = Data[i] | ((msbs & 0x01) << 7);
+			msbs >>= 1;
+		}
+	}
+	Data += STORE_PACKED_LEN;
+	crc = Data[0] | ((INT16U)Data[1] << 7) | ((INT16U)Data[2] << 14);
+	if(Crc16(CRC_INIT, stage, STORE_BLOCK_LEN) != crc){
+		return STORE_BAD_CRC;
+	}else{}
+	dest = (INT8U *)Target + STORE_BODY + (block * STORE_BLOCK_LEN);
+	FlashWrite(dest, stage, STORE_BLOCK_LEN);
+	Written |= (INT32U)1 << block;
+	for(i=0;i<STORE_BLOCK_LEN;i++){
+		if(dest[i] != stage[i]){
+			return STORE_VERIFY;
+		}else{}
+	}
+	return STORE_OK;
+}
+/******************************************************************************
+ * StoreCommit() - Complete the body from the image in use, write the header
+ * and switch the tables over. The old image stays as the fallback until the
+ * next BEGIN erases it.
+ *****************************************************************************/
+INT8U StoreCommit(void){
+	INT16U i;
+	INT8U byte;
+	INT8U *body;
+	INT16U sequence = Active ? Active->Sequence + 1 : 1;
+	INT16U crc;
+	INT16U magic = STORE_MAGIC;
+	if(!Target){
+		return STORE_NOT_OPEN;
+	}else{}
+	body = (INT8U *)Target + STORE_BODY;
+	for(i=0;i<STORE_BODY_LEN;i++){
+		if(!(Written & ((INT32U)1 << (i / STORE_BLOCK_LEN))) ||
+		   ((i < sizeof(STORE_PARAMS)) && (body[i] == STORE_ERASED))){
+			byte = SourceByte(i);
+			if(byte != STORE_ERASED){
+				FlashWrite(&body[i], &byte, 1);
+			}else{}
+		}else{}
+	}
+	crc = Crc16(CRC_INIT, body, STORE_BODY_LEN);
+	FlashWrite((INT8U *)&Target->Sequence, (const INT8U *)&sequence, sizeof(sequence));
+	FlashWrite((INT8U *)&Target->Crc, (const INT8U *)&crc, sizeof(crc));
+	FlashWrite((INT8U *)&Target->Magic, (const INT8U *)&magic, sizeof(magic));
+	if(!ImageValid(Target)){
+		Target = 0;
+		return STORE_VERIFY;
+	}else{}
+	Active = Target;
+	Target = 0;
+	StoreApply();
+	return STORE_OK;
+}
+/******************************************************************************
+ * StoreSequence() - Sequence number of the image in use, 0 for the defaults.
+ *****************************************************************************/
+INT16U StoreSequence(void){
+	return Active ? Active->Sequence : 0;
+}
+/******************************************************************************
+ * ImageValid(const STORE_IMAGE *) - Magic and body CRC check.
+ *****************************************************************************/
+INT8U ImageValid(const STORE_IMAGE *Image){
+	return (Image->Magic == STORE_MAGIC) &&
+		   (Crc16(CRC_INIT, (const INT8U *)Image + STORE_BODY, STORE_BODY_LEN) == Image->Crc);
+}
+/******************************************************************************
+ * SourceByte(INT16U) - Body byte at Offset of the image in use, or of the
+ * compiled defaults laid out the same way.
+ *****************************************************************************/
+INT8U SourceByte(INT16U Offset){
+	if(Active){
+		return ((const INT8U *)Active)[STORE_BODY + Offset];
+	}else if(Offset < sizeof(STORE_PARAMS)){
+		return ((const INT8U *)&DefaultParams)[Offset];
+	}else if(Offset < sizeof(STORE_PARAMS) + sizeof(PeriodLookup)){
+		return ((const INT8U *)PeriodLookup)[Offset - sizeof(STORE_PARAMS)];
+	}else{
+		return OnTimeLookup[Offset - sizeof(STORE_PARAMS) - sizeof(PeriodLookup)];
+	}
+}
+/******************************************************************************
+ * StoreApply() - Point the tables at the image in use and load its
+ * parameters. Parameters out of range keep their compiled defaults.
+ *****************************************************************************/
+void StoreApply(void){
+	const STORE_PARAMS *params = Active ? &Active->Params : &DefaultParams;
+	if(Active){
+		PeriodTable = Active->Period;
+		OnTimeTable = Active->OnTime;
+	}else{
+		PeriodTable = PeriodLookup;
+		OnTimeTable = OnTimeLookup;
+	}
+	MidiChannel = (params->Channel <= CHANNEL_MASK) ? params->Channel : CONTROLLER_CHANNEL;
+	BendRange = (params->BendRange <= BEND_RANGE_MAX) ? params->BendRange : BEND_RANGE;
+	NotePriority = (params->NotePriority <= LOWEST_NOTE_PRIORITY) ? params->NotePriority : NOTE_PRIORITY;
+	ThruFilter = (params->ThruFilter <= THRU_FILTER_ALL) ? params->ThruFilter : THRU_FILTER;
+	MidiSetOmni((params->Omni <= TRUE) ? params->Omni : OMNI_MODE);
+	SynthSetDutyCeiling(params->DutyCeiling);
+}
+/******************************************************************************
+ * Crc16(INT16U, const INT8U *, INT16U) - CRC16-CCITT, bit at a time.
+ *****************************************************************************/
+INT16U Crc16(INT16U Crc, const INT8U *Data, INT16U Len){
+	INT8U i;
+	while(Len--){
+		Crc ^= (INT16U)*Data++ << 8;
+		for(i=0;i<8;i++){
+			if(Crc & 0x8000){
+				Crc = (Crc << 1) ^ CRC_POLY;
+			}else{
+				Crc <<= 1;
+			}
+		}
+	}
+	return Crc;
+}
+/******************************************************************************
+ * FlashErase(INT8U *) - Erase one 512 byte segment with a dummy write.
+ *****************************************************************************/
+void FlashErase(INT8U *Segment){
+	__disable_interrupt();
+	FCTL3 = FWKEY;
+	FCTL1 = (FWKEY | ERASE);
+	*Segment = 0;
+	FCTL1 = FWKEY;
+	FCTL3 = (FWKEY | LOCK);
+	__enable_interrupt();
+}
+/******************************************************************************
+ * FlashWrite(INT8U *, const INT8U *, INT8U) - Program erased bytes.
+ *****************************************************************************/
+void FlashWrite(INT8U *Dest, const INT8U *Src, INT8U Len){
+	__disable_interrupt();
+	FCTL3 = FWKEY;
+	FCTL1 = (FWKEY | WRT);
+	while(Len--){
+		*Dest++ = *Src++;
+	}
+	FCTL1 = FWKEY;
+	FCTL3 = (FWKEY | LOCK);
+	__enable_interrupt();
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Store.h - Header for the Store.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Private Functions
+ *****************************************************************************/
+static INT8U ImageValid(const STORE_IMAGE *Image);
+static INT8U SourceByte(INT16U Offset);
+static void StoreApply(void);
+static INT16U Crc16(INT16U Crc, const INT8U *Data, INT16U Len);
+static void FlashErase(INT8U *Segment);
+static void FlashWrite(INT8U *Dest, const INT8U *Src, INT8U Len);
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void StoreInit(void);
+INT8U StoreBegin(void);
+INT8U StoreBlock(INT8U *Data, INT8U Len);
+INT8U StoreCommit(void);
+INT16U StoreSequence(void);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define STORE_SEGMENTS     2
+#define FLASH_SEG_LEN      512
+/*StoreFlash in Store.c; the simulator supplies its own segments*/
+#ifndef FLASH_SEGMENT
+#define FLASH_SEGMENT(n)   ((INT8U *)StoreFlash[n])
+#define STORE_FLASH
+#endif
+#define STORE_MAGIC        0xA55A
+#define STORE_BLOCK_LEN    16		/*Bytes per BLOCK message*/
+#define STORE_BODY         offsetof(STORE_IMAGE, Params)
+#define STORE_BODY_LEN     (sizeof(STORE_IMAGE) - STORE_BODY)
+#define STORE_BLOCKS       (STORE_BODY_LEN / STORE_BLOCK_LEN)
+#define STORE_PACKED_LEN   (STORE_BLOCK_LEN + (STORE_BLOCK_LEN + 6) / 7)
+#define STORE_MSG_LEN      (1 + STORE_PACKED_LEN + 3)	/*Block, data, CRC*/
+#define STORE_ERASED       0xFF
+#define CRC_INIT           0xFFFF
+#define CRC_POLY           0x1021
+#define FLASH_CLOCK        (FWKEY | FSSEL_1 | FN5 | FN2 | FN1 | FN0)	/*16 MHz / 40*/
+
+/*Status codes in the replies*/
+#define STORE_OK           0
+#define STORE_NOT_OPEN     1		/*No BEGIN since the last COMMIT*/
+#define STORE_BAD_BLOCK    2		/*Out of range, short or already written*/
+#define STORE_BAD_CRC      3
+#define STORE_VERIFY       4		/*Flash does not read back*/
@@ -0,0 +1,422 @@
+/******************************************************************************
+ * Synth.c - Drives the enable output from TA0. Mono mode runs TA0 in up mode
+ * with TA0CCR0 as the period and TA0CCR1 as the on time. Poly mode runs TA0
+ * continuously and schedules one pulse at a time from a set of voices; each
+ * pulse is set at TA0CCR1 and reset at TA0CCR0 in hardware, and the TA0CCR0
+ * interrupt plans the next one.
+ *
+ * Both modes share a duty limiter: a leaky bucket of on time. Each output
+ * change sets the rate at which on time is spent, the WDT tick adds that rate
+ * and drains the bucket at the duty ceiling, and past DUTY_SOFT the on time is
+ * scaled down linearly until it reaches zero at DUTY_HARD.
+ *
+ * Mono mode runs TA0 at SMCLK/4 for the best resolution, and at SMCLK/8 for
+ * the keys below SYNTH_SLOW_KEYS whose periods do not fit 16 bits at SMCLK/4.
+ * Periods and on times are passed in SMCLK/4 ticks throughout, so the duty
+ * limiter never sees the prescaler; the mono timer halves both at SMCLK/8.
+ *
+ * SynthGate() switches the output off and on over the top of both modes for
+ * the tempo gate of Clock.c and the burst engine of Burst.c; the output only
+ * runs while neither holds it off, and on time is not spent while it is held.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+
+static SYNTH_VOICE Voices[SYNTH_VOICES];
+static INT8U VoiceOnTime[SYNTH_VOICES];	/*Beside Voices so each voice packs to 4 bytes*/
+static INT8U Poly = FALSE;			/*TA0 configured for the pulse scheduler*/
+static INT8U Running = FALSE;		/*A scheduled pulse is pending*/
+static INT8U FiredMask = 0;			/*Voices served by the pending pulse*/
+static INT16U PulseStart;			/*TA0R of the pending pulse*/
+static INT8U MonoOnTime = 0;		/*Unscaled mono on time*/
+static INT8U MonoSlow = FALSE;		/*Mono TA0 at SMCLK/8*/
+static INT16U DutyRate = 0;			/*On time spent per WDT tick, unscaled*/
+static INT16U DutyBudget = 0;		/*On time in the bucket*/
+static INT16U DutyScale = DUTY_SCALE_ONE;	/*On time scale, 256 is full*/
+static INT16U DutyLeak = DUTY_LEAK;	/*Ceiling in on time per WDT tick*/
+static INT8U GateClosed = 0;		/*SYNTH_GATE_ sources holding the output off*/
+
+/*(1 << DUTY_TICK_SHIFT) / p rounded up, for p = 32 to 63; see PulseRate()*/
+static const INT16U RateRecip[RATE_RECIP_LEN] = {
+	256, 249, 241, 235, 228, 222, 216, 211, 205, 200, 196, 191, 187, 183, 179, 175,
+	171, 168, 164, 161, 158, 155, 152, 149, 147, 144, 142, 139, 137, 135, 133, 131
+};
+
+/******************************************************************************
+ * SynthInit() - Configure TA0 for mono output with the output held low.
+ *****************************************************************************/
+void SynthInit(void){
+	SynthStop();
+}
+/******************************************************************************
+ * SynthStop() - Silence the output and return TA0 to mono mode.
+ *****************************************************************************/
+void SynthStop(void){
+	SetMonoConfig();
+	TA0CCR1  = 0;
+	MonoOnTime = 0;
+    P2OUT &= ~ENABLE_OUT_PIN;
+}
+/******************************************************************************
+ * SynthPeriod(INT8U) - Period of a key from PeriodTable in SMCLK/4 ticks.
+ * Entries below SYNTH_SLOW_KEYS are kept in SMCLK/8 ticks.
+ *****************************************************************************/
+INT32U SynthPeriod(INT8U Key){
+	if(Key < SYNTH_SLOW_KEYS){
+		return (INT32U)PeriodTable[Key] << 1;
+	}else{
+		return PeriodTable[Key];
+	}
+}
+/******************************************************************************
+ * SynthSetMono(INT32U, INT8U) - Output a single continuous pulse train. A
+ * Period of zero halts TA0 with the output forced low; halting it with
+ * TA0CCR0 alone would leave a pulse under way stuck high. Periods past
+ * MAX_CCR0 switch TA0 to SMCLK/8, see SetMonoPrescaler().
+ *****************************************************************************/
+void SynthSetMono(INT32U Period, INT8U OnTime){
+	INT16U rate = PulseRate(Period, OnTime);
+	INT8U slow = (Period > MAX_CCR0);
+	INT16U ticks = slow ? (INT16U)(Period >> 1) : (INT16U)Period;
+	if(Poly){
+		SetMonoConfig();
+	}else{}
+	__disable_interrupt();
+	MonoOnTime = OnTime;
+	DutyRate = rate;
+	if(Period == 0){
+		TA0CCTL1 = SYNTH_MONO_OFF;
+		TA0CCR0 = 0;
+	}else{
+		if(slow != MonoSlow){
+			SetMonoPrescaler(slow, ticks);	/*Leaves TA0 halted*/
+		}else{}
+		if((TA0CCR0 == 0) && !GateClosed){	/*Halted; next rollover sets the output*/
+			TA0CCTL1 = SYNTH_MONO_CCTL1;
+		}else{}
+		SetMonoOnTime(DutyScaled(OnTime));
+		TA0CCR0 = ticks;
+		TA0CTL |= MC_1;
+	}
+	__enable_interrupt();
+}
+/******************************************************************************
+ * SynthSetVoice(INT8U, INT32U, INT8U) - Set the period and on time of a poly
+ * voice. A Period or OnTime of zero idles the voice. A voice that was idle
+ * fires shortly after; a voice that was already playing keeps its phase.
+ * Poly mode stays at SMCLK/4, so keys that need SMCLK/8 are idle.
+ *****************************************************************************/
+void SynthSetVoice(INT8U Voice, INT32U Period, INT8U OnTime){
+	SYNTH_VOICE *v = &Voices[Voice];
+	INT16U rate;
+	if((Period >= POLY_LATE_LIMIT)||(OnTime == 0)){	/*Out of scheduler range*/
+		Period = 0;
+	}else{}
+	if(!Poly){
+		SetPolyConfig();
+	}else{}
+	if((v->Period != Period)||(VoiceOnTime[Voice] != OnTime)){
+		rate = PulseRate(Period, OnTime) - PulseRate(v->Period, VoiceOnTime[Voice]);
+		__disable_interrupt();
+		if(v->Period == 0){
+			v->NextFire = TA0R + POLY_SCHED_LEAD;
+		}else{}
+		v->Period = (INT16U)Period;
+		VoiceOnTime[Voice] = OnTime;
+		DutyRate += rate;
+		Reschedule();
+		__enable_interrupt();
+	}else{}
+}
+/******************************************************************************
+ * SynthDutyTick() - Called from the WDT interrupt. Spends the on time of the
+ * last tick, leaks the ceiling and rescales the on time when the budget moves
+ * past DUTY_SOFT.
+ *****************************************************************************/
+void SynthDutyTick(void){
+	INT16U budget = DutyBudget;
+	INT16U scale;
+	if(!GateClosed){
+		budget += DutyScaled(DutyRate);
+	}else{}
+	if(budget > DutyLeak){
+		budget -= DutyLeak;
+	}else{
+		budget = 0;
+	}
+	if(budget > DUTY_HARD){
+		budget = DUTY_HARD;
+	}else{}
+	DutyBudget = budget;
+	if(budget <= DUTY_SOFT){
+		scale = DUTY_SCALE_ONE;
+	}else{
+		scale = (DUTY_HARD - budget) >> DUTY_SLOPE_SHIFT;
+	}
+	if(scale != DutyScale){
+		DutyScale = scale;
+		if(!Poly && TA0CCR0){			/*Poly picks it up on the next pulse*/
+			SetMonoOnTime(DutyScaled(MonoOnTime));
+		}else{}
+	}else{}
+}
+/******************************************************************************
+ * SynthGate(INT8U, INT8U) - Open or close the output gate for one source.
+ * The gate closes with the first source and opens with the last. Closing
+ * forces the output low at once, cutting a pulse under way short. Opening
+ * restarts the pulse train so its first pulse starts on the gate edge: mono
+ * mode moves TA0R to the end of the period and poly mode refires every voice.
+ * Called with interrupts disabled.
+ *****************************************************************************/
+void SynthGate(INT8U Source, INT8U Open){
+	INT8U i;
+	INT8U closed = Open ? (GateClosed & ~Source) : (GateClosed | Source);
+	Open = (closed == 0);
+	if(Open == (GateClosed == 0)){
+		GateClosed = closed;
+		return;
+	}else{}
+	GateClosed = closed;
+	if(Poly){
+		if(Open){
+			for(i=0;i<SYNTH_VOICES;i++){
+				Voices[i].NextFire = TA0R + POLY_SCHED_LEAD;
+			}
+			Reschedule();
+		}else{
+			TA0CCTL1 = OUTMOD_0;
+		}
+	}else if(TA0CCR0){
+		if(Open){
+			TA0CTL &= ~MC_3;
+			TA0R = TA0CCR0 - 1;				/*Next count sets the output*/
+			TA0CCTL1 = SYNTH_MONO_CCTL1;
+			TA0CTL |= MC_1;
+		}else{
+			TA0CCTL1 = SYNTH_MONO_OFF;
+		}
+	}else{}
+}
+/******************************************************************************
+ * SynthSetDutyCeiling(INT8U) - Set the long term duty ceiling in percent.
+ * Out of range values select DUTY_CEILING_PCT.
+ *****************************************************************************/
+void SynthSetDutyCeiling(INT8U Percent){
+	if((Percent == 0)||(Percent > DUTY_CEILING_MAX)){
+		Percent = DUTY_CEILING_PCT;
+	}else{}
+	DutyLeak = (INT16U)(((INT32U)Percent << DUTY_TICK_SHIFT) / 100);
+}
+/******************************************************************************
+ * SynthDutyLevel() - The budget used, 0 to 128. Scaling starts at 64.
+ *****************************************************************************/
+INT8U SynthDutyLevel(void){
+	return (INT8U)(DutyBudget >> 8);
+}
+/******************************************************************************
+ * SetMonoConfig() - Up mode; TA0CCR1 resets the output and the TA0CCR0
+ * rollover sets it. TA0 is left halted with the output low.
+ *****************************************************************************/
+void SetMonoConfig(void){
+	INT8U i;
+	__disable_interrupt();
+	for(i=0;i<SYNTH_VOICES;i++){
+		Voices[i].Period = 0;
+	}
+	Running = FALSE;
+	FiredMask = 0;
+	Poly = FALSE;
+	MonoSlow = FALSE;
+	DutyRate = 0;
+	__enable_interrupt();
+    TA0CCTL1 = SYNTH_MONO_OFF;			/*Force output low*/
+    TA0CCR0  = 0;
+    TA0CTL   = (SYNTH_MONO_CTL | TACLR);
+    TA0CCTL0 = (CM_0 | CCIS_0 | OUTMOD_4);
+}
+/******************************************************************************
+ * SetPolyConfig() - Continuous mode with the output held low until the first
+ * pulse is scheduled.
+ *****************************************************************************/
+void SetPolyConfig(void){
+	TA0CCTL1 = OUTMOD_0;			/*Force output low*/
+	TA0CCTL0 = 0;
+	TA0CTL   = (SYNTH_POLY_CTL | TACLR);
+	TA0CCTL0 = CCIE;
+	Running = FALSE;
+	FiredMask = 0;
+	DutyRate = 0;
+	MonoOnTime = 0;
+	Poly = TRUE;
+}
+/******************************************************************************
+ * SetMonoPrescaler(INT8U, INT16U) - Switch mono TA0 between SMCLK/4 and
+ * SMCLK/8 for a new Period in ticks of the new clock. TA0 is halted and its
+ * count rescaled, so once the caller sets the reset point in the new ticks a
+ * pulse under way ends on time and the period under way keeps its phase. A
+ * count past the new period starts the next period at once. The output keeps
+ * its level while halted; TA0 is left halted for the caller to set TA0CCR1
+ * and TA0CCR0 and restart. Called with interrupts disabled.
+ *****************************************************************************/
+void SetMonoPrescaler(INT8U Slow, INT16U Period){
+	INT16U count;
+	TA0CTL &= ~MC_3;
+	count = TA0R;
+	if(Slow){
+		count >>= 1;
+		TA0CTL = (TA0CTL & ~ID_3) | SYNTH_SLOW_ID;
+	}else{
+		count = (count < 0x8000) ? (count << 1) : MAX_CCR0;
+		TA0CTL = (TA0CTL & ~ID_3) | SYNTH_FAST_ID;
+	}
+	if(count >= Period){
+		count = Period - 1;					/*Next count sets the output*/
+	}else{}
+	TA0R = count;
+	MonoSlow = Slow;
+}
+/******************************************************************************
+ * SetMonoOnTime(INT16U) - Move the mono reset point. If the pulse under way
+ * is already past the new point the compare would be missed and the output
+ * held high for a whole period, so the pulse is ended now instead. OnTime is
+ * in SMCLK/4 ticks. The pulse lasts one tick past the compare, OnTime + 1
+ * ticks, so at SMCLK/8 the compare is OnTime / 2 for the same width to half
+ * a tick. Called with interrupts disabled.
+ *****************************************************************************/
+void SetMonoOnTime(INT16U OnTime){
+	if(MonoSlow){
+		OnTime >>= 1;
+	}else{}
+	TA0CCR1 = OnTime;
+	if((P2IN & ENABLE_OUT_PIN) && (TA0R >= OnTime)){
+		TA0CCTL1 = SYNTH_MONO_OFF;
+		TA0CCTL1 = SYNTH_MONO_CCTL1;
+	}else{}
+}
+/******************************************************************************
+ * PulseRate(INT32U, INT8U) - On time a pulse train spends per WDT tick, in
+ * SMCLK/4 ticks: OnTime * 8192 / Period without a division. Period is shifted
+ * down to its leading six bits and OnTime scaled by their reciprocal in
+ * RateRecip, then shifted back. The rate is at most 3.4% high, so the limiter
+ * errs on the safe side; a period under 32 ticks is taken as 32.
+ *****************************************************************************/
+INT16U PulseRate(INT32U Period, INT8U OnTime){
+	INT8U shift = 0;
+	if(Period == 0){
+		return 0;
+	}else if(Period < RATE_RECIP_LEN){
+		Period = RATE_RECIP_LEN;
+	}else{}
+	while(Period >= (2 * RATE_RECIP_LEN)){
+		Period >>= 1;
+		shift++;
+	}
+	return ScaleQ8((INT16U)OnTime << 8, RateRecip[(INT8U)Period - RATE_RECIP_LEN]) >> shift;
+}
+/******************************************************************************
+ * DutyScaled(INT16U) - Value times the limiter scale, see ScaleQ8().
+ *****************************************************************************/
+INT16U DutyScaled(INT16U Value){
+	INT16U scale = DutyScale;
+	if(scale >= DUTY_SCALE_ONE){
+		return Value;
+	}else{
+		return ScaleQ8(Value, scale);
+	}
+}
+/******************************************************************************
+ * Reschedule() - Replan the pending pulse after a voice change. A pulse that
+ * is under way or about to start is left alone; the TA0CCR0 interrupt picks
+ * the change up when it ends. Called with interrupts disabled.
+ *****************************************************************************/
+void Reschedule(void){
+	INT16U lead;
+	if(!Running){
+		SchedulePulse(TA0R + POLY_SCHED_LEAD);
+	}else if(!(P2IN & ENABLE_OUT_PIN) && !(TA0CCTL0 & CCIFG)){
+		lead = TA0CCR1 - TA0R;
+		if((lead > POLY_SCHED_LEAD)&&(lead < POLY_LATE_LIMIT)){
+			SchedulePulse(TA0R + POLY_SCHED_LEAD);
+		}else{}
+	}else{}
+}
+/******************************************************************************
+ * SchedulePulse(INT16U) - Program the next pulse at or after Earliest for the
+ * voice that is due first. Other voices due before the pulse ends plus
+ * POLY_MIN_GAP are merged into it; the merged pulse takes the widest on time.
+ *****************************************************************************/
+void SchedulePulse(INT16U Earliest){
+	INT8U i;
+	INT8U bit;
+	INT8U first = SYNTH_VOICES;
+	INT8U width;
+	INT8U mask = 0;
+	INT16U wait = POLY_LATE_LIMIT;
+	INT16U delta;
+
+	for(i=0;i<SYNTH_VOICES;i++){				/*Find the earliest voice*/
+		if(Voices[i].Period){
+			delta = Voices[i].NextFire - Earliest;
+			if(delta >= POLY_LATE_LIMIT){		/*Late; fire as soon as possible*/
+				delta = 0;
+			}else{}
+			if(delta < wait){
+				wait = delta;
+				first = i;
+			}else{}
+		}else{}
+	}
+	if(first == SYNTH_VOICES){					/*All voices idle*/
+		TA0CCTL1 = OUTMOD_0;
+		Running = FALSE;
+		FiredMask = 0;
+		return;
+	}else{}
+
+	PulseStart = Earliest + wait;
+	width = VoiceOnTime[first];
+	bit = 0x01;
+	for(i=0;i<SYNTH_VOICES;i++){				/*Merge colliding voices*/
+		if(Voices[i].Period){
+			delta = Voices[i].NextFire - PulseStart;
+			if((delta < (INT16U)width + POLY_MIN_GAP)||(delta >= POLY_LATE_LIMIT)){
+				mask |= bit;
+				if(VoiceOnTime[i] > width){
+					width = VoiceOnTime[i];
+				}else{}
+			}else{}
+		}else{}
+		bit <<= 1;
+	}
+	FiredMask = mask;
+	Running = TRUE;
+	width = (INT8U)DutyScaled(width);
+	TA0CCR1  = PulseStart;
+	if(width && !GateClosed){
+		TA0CCR0  = PulseStart + width;
+		TA0CCTL1 = OUTMOD_3;
+	}else{										/*Throttled or gated; keep the slot silent*/
+		TA0CCR0  = PulseStart + 1;
+		TA0CCTL1 = OUTMOD_0;
+	}
+}
+/******************************************************************************
+ * SynthPulseEnd() - TA0 CCR0 Interrupt, called when a poly pulse ends.
+ * Advances the voices the pulse served and plans the next pulse.
+ *****************************************************************************/
+#pragma vector=TIMER0_A0_VECTOR
+__interrupt void SynthPulseEnd(void){
+	INT8U i;
+	INT8U bit = 0x01;
+	for(i=0;i<SYNTH_VOICES;i++){
+		if(FiredMask & bit){
+			Voices[i].NextFire += Voices[i].Period;
+			if((INT16U)(Voices[i].NextFire - PulseStart) >= POLY_LATE_LIMIT){
+				Voices[i].NextFire = PulseStart + Voices[i].Period;	/*Rephase*/
+			}else{}
+		}else{}
+		bit <<= 1;
+	}
+	SchedulePulse(TA0CCR0 + POLY_MIN_GAP);
+}
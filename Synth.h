@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Synth.h - Header for the Synth.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Private Functions
+ *****************************************************************************/
+static void SetMonoConfig(void);
+static void SetPolyConfig(void);
+static void SchedulePulse(INT16U Earliest);
+static void Reschedule(void);
+static void SetMonoPrescaler(INT8U Slow, INT16U Period);
+static void SetMonoOnTime(INT16U OnTime);
+static INT16U PulseRate(INT32U Period, INT8U OnTime);
+static INT16U DutyScaled(INT16U Value);
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void SynthInit(void);
+void SynthStop(void);
+INT32U SynthPeriod(INT8U Key);
+void SynthSetMono(INT32U Period, INT8U OnTime);
+void SynthSetVoice(INT8U Voice, INT32U Period, INT8U OnTime);
+void SynthDutyTick(void);
+void SynthGate(INT8U Source, INT8U Open);
+void SynthSetDutyCeiling(INT8U Percent);
+INT8U SynthDutyLevel(void);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define SYNTH_VOICES     4
+#define SYNTH_SLOW_KEYS  35			/*Keys below run mono TA0 at SMCLK/8*/
+#define SYNTH_FAST_ID    ID_2		/*SMCLK/4*/
+#define SYNTH_SLOW_ID    ID_3		/*SMCLK/8*/
+#define POLY_MIN_GAP     400		/*100 us between merged pulses*/
+#define POLY_SCHED_LEAD  200		/*50 us lead when scheduling from the loop*/
+#define POLY_LATE_WINDOW 0x0800		/*Fire times this far behind are late*/
+#define POLY_LATE_LIMIT  (INT16U)(0x10000 - POLY_LATE_WINDOW)
+#define SYNTH_MONO_CTL   (TASSEL_2 | SYNTH_FAST_ID | MC_1)
+#define SYNTH_POLY_CTL   (TASSEL_2 | ID_2 | MC_2)
+#define SYNTH_MONO_CCTL1 (CM_0 | CCIS_0 | SCS | CAP | OUTMOD_7)
+#define SYNTH_MONO_OFF   (CM_0 | CCIS_0 | SCS | CAP | OUTMOD_0)
+#define SYNTH_GATE_CLOCK 0x01		/*SynthGate() sources*/
+#define SYNTH_GATE_BURST 0x02
+
+/*Duty limiter; the budget is in TA0 ticks of on time*/
+#define DUTY_CEILING_PCT 5			/*Default long term duty ceiling*/
+#define DUTY_CEILING_MAX 50
+#define DUTY_TICK_SHIFT  13			/*8192 TA0 ticks per 2.048 ms WDT tick*/
+#define DUTY_LEAK        (INT16U)(((INT32U)DUTY_CEILING_PCT << DUTY_TICK_SHIFT) / 100)
+#define DUTY_SOFT        0x4000		/*Budget used before the on time is scaled*/
+#define DUTY_HARD        0x8000		/*Budget at which the on time reaches zero*/
+#define DUTY_SLOPE_SHIFT 6			/*(DUTY_HARD - DUTY_SOFT) >> 6 == DUTY_SCALE_ONE*/
+#define DUTY_SCALE_ONE   256
+#define RATE_RECIP_LEN   32			/*PulseRate() reciprocals, 5 bits below the leading one*/
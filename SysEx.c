@@ -0,0 +1,190 @@
+/******************************************************************************
+ * SysEx.c - System exclusive command interface. Messages addressed to
+ * SYSEX_ID are collected between F0 and F7 and run once complete:
+ *
+ *   F0 7D <command> [data] F7
+ *
+ * Replies carry the command with SYSEX_REPLY set. 16 bit words are sent as
+ * three 7 bit bytes, least significant first.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+#include "SysEx.h"
+
+static INT8U SysExBuffer[SYSEX_BUFF_LEN];
+static INT8U SysExCount = 0;		/*Body bytes received, saturates past the buffer*/
+
+#if MIDI_LATENCY
+extern INT16U LatencyHist[LATENCY_BUCKETS];
+extern INT16U LatencyMax;
+#endif
+#if TRACE
+extern TRACE_RECORD TraceRing[TRACE_LEN];
+extern INT8U TraceHead;
+extern INT8U TraceHold;
+static INT8U DumpIndex;				/*Record being sent*/
+static INT8U DumpLeft;				/*Records left to send*/
+static INT8U DumpStep;				/*Byte of the record being sent*/
+#endif
+
+/******************************************************************************
+ * SysExStart() - Drops the message being collected. Called for every status
+ * byte but an F7 ending a SysEx message, so the buffer only holds the bytes
+ * after the latest F0 while that message is still open.
+ *****************************************************************************/
+void SysExStart(void){
+	SysExCount = 0;
+}
+/******************************************************************************
+ * SysExByte(INT8U) - Collects one data byte of the message.
+ *****************************************************************************/
+void SysExByte(INT8U Byte){
+	if(SysExCount < SYSEX_BUFF_LEN){
+		SysExBuffer[SysExCount] = Byte;
+		SysExCount++;
+	}else if(SysExCount < 0xFF){
+		SysExCount++;
+	}else{}
+}
+/******************************************************************************
+ * SysExEnd() - Runs a complete message addressed to us. Overlong messages and
+ * messages for other manufacturers are ignored.
+ *****************************************************************************/
+void SysExEnd(void){
+	INT8U status;
+	if(SysExCount < 2 || SysExCount > SYSEX_BUFF_LEN || SysExBuffer[0] != SYSEX_ID){
+		SysExCount = 0;
+		return;
+	}else{}
+	switch(SysExBuffer[1]){
+#if MIDI_LATENCY
+	case SYSEX_LATENCY_DUMP:
+		SendLatency();
+		break;
+	case SYSEX_LATENCY_RESET:
+		ResetLatency();
+		break;
+#endif
+#if TRACE
+	case SYSEX_TRACE_DUMP:
+		SendTrace();
+		break;
+#endif
+	case SYSEX_STORE_BEGIN:
+		status = StoreBegin();
+		SendStatus(SYSEX_STORE_BEGIN, status, StoreSequence());
+		break;
+	case SYSEX_STORE_BLOCK:
+		status = StoreBlock(&SysExBuffer[2], SysExCount - 2);
+		SendStatus(SYSEX_STORE_BLOCK, status, SysExBuffer[2]);
+		break;
+	case SYSEX_STORE_COMMIT:
+		status = StoreCommit();
+		SendStatus(SYSEX_STORE_COMMIT, status, StoreSequence());
+		break;
+	default:
+		break;
+	}
+	SysExCount = 0;
+}
+#if MIDI_LATENCY
+/******************************************************************************
+ * SendLatency() - Replies with the note latency histogram: LATENCY_BUCKETS
+ * counts (bucket 0 is 0 us, bucket n covers 2^(n-1) to 2^n - 1 us, the last
+ * bucket everything above) followed by the worst latency in us.
+ *****************************************************************************/
+void SendLatency(void){
+	INT8U i;
+	MidiTxHold(TRUE);
+	MidiTx(SYSTEM_EXCLUSIVE);
+	MidiTx(SYSEX_ID);
+	MidiTx(SYSEX_LATENCY_DUMP | SYSEX_REPLY);
+	for(i=0;i<LATENCY_BUCKETS;i++){
+		SendWord(LatencyHist[i]);
+	}
+	SendWord(LatencyMax);
+	MidiTx(END_OF_SYSTEM_EXCLUSIVE);
+	MidiTxHold(FALSE);
+}
+#endif
+#if TRACE
+/******************************************************************************
+ * SendTrace() - Replies with the trace ring, oldest record first: the time
+ * stamp as a word, then the code and argument as two bytes each, low 7 bits
+ * first. Records not yet written have code TRACE_NONE. The records are fed
+ * to MIDI out by TraceDumpByte() from the TX interrupt, so the main loop
+ * does not wait the 70 ms the reply takes. Logging is held off until the
+ * ring is sent so it goes out as one snapshot; a request during a dump is
+ * ignored.
+ *****************************************************************************/
+void SendTrace(void){
+	if(TraceHold){
+		return;
+	}else{}
+	TraceHold = TRUE;
+	DumpIndex = TraceHead;
+	DumpLeft = TRACE_LEN;
+	DumpStep = 0;
+	MidiTxHold(TRUE);
+	MidiTx(SYSTEM_EXCLUSIVE);
+	MidiTx(SYSEX_ID);
+	MidiTx(SYSEX_TRACE_DUMP | SYSEX_REPLY);
+	MidiTxStream(TraceDumpByte);
+}
+/******************************************************************************
+ * TraceDumpByte(INT8U *) - Next byte of the trace dump, see SendTrace().
+ * Returns FALSE after the F7 and releases the ring. Called from MIDI_TX().
+ *****************************************************************************/
+INT8U TraceDumpByte(INT8U *Byte){
+	const TRACE_RECORD *record = &TraceRing[DumpIndex];
+	if(DumpLeft == 0){
+		if(DumpStep == 0){
+			*Byte = END_OF_SYSTEM_EXCLUSIVE;
+			DumpStep++;
+			return TRUE;
+		}else{
+			TraceHold = FALSE;
+			return FALSE;
+		}
+	}else{}
+	switch(DumpStep){
+	case 0:  *Byte = record->Time & 0x7F;        break;
+	case 1:  *Byte = (record->Time >> 7) & 0x7F; break;
+	case 2:  *Byte = record->Time >> 14;         break;
+	case 3:  *Byte = record->Code & 0x7F;        break;
+	case 4:  *Byte = record->Code >> 7;          break;
+	case 5:  *Byte = record->Arg & 0x7F;         break;
+	default: *Byte = record->Arg >> 7;           break;
+	}
+	DumpStep++;
+	if(DumpStep == TRACE_RECORD_BYTES){
+		DumpStep = 0;
+		DumpIndex = (DumpIndex + 1) & TRACE_MASK;
+		DumpLeft--;
+	}else{}
+	return TRUE;
+}
+#endif
+/******************************************************************************
+ * SendStatus(INT8U, INT8U, INT16U) - Replies to a store command with its
+ * status code and a word: the image sequence, or the block number.
+ *****************************************************************************/
+void SendStatus(INT8U Command, INT8U Status, INT16U Word){
+	MidiTxHold(TRUE);
+	MidiTx(SYSTEM_EXCLUSIVE);
+	MidiTx(SYSEX_ID);
+	MidiTx(Command | SYSEX_REPLY);
+	MidiTx(Status);
+	SendWord(Word);
+	MidiTx(END_OF_SYSTEM_EXCLUSIVE);
+	MidiTxHold(FALSE);
+}
+/******************************************************************************
+ * SendWord(INT16U) - Sends a word as three 7 bit data bytes.
+ *****************************************************************************/
+void SendWord(INT16U Word){
+	MidiTx(Word & 0x7F);
+	MidiTx((Word >> 7) & 0x7F);
+	MidiTx(Word >> 14);
+}
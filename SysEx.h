@@ -0,0 +1,34 @@
+/******************************************************************************
+ * SysEx.h - Header for the SysEx.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Private Functions
+ *****************************************************************************/
+static void SendLatency(void);
+static void SendTrace(void);
+static INT8U TraceDumpByte(INT8U *Byte);
+static void SendWord(INT16U Word);
+static void SendStatus(INT8U Command, INT8U Status, INT16U Word);
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void SysExStart(void);
+void SysExByte(INT8U Byte);
+void SysExEnd(void);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define SYSEX_ID            0x7D	/*Non-commercial manufacturer ID*/
+#define SYSEX_BUFF_LEN      (2 + STORE_MSG_LEN)	/*ID, command, store block*/
+#define SYSEX_REPLY         0x40	/*Set in the command byte of replies*/
+#define TRACE_RECORD_BYTES  7		/*Time word, code and argument in the dump*/
+
+/*Commands*/
+#define SYSEX_LATENCY_DUMP  0x01	/*Reply: buckets, max; 3 bytes per word*/
+#define SYSEX_LATENCY_RESET 0x02
+#define SYSEX_TRACE_DUMP    0x03	/*Reply: TRACE_LEN records of 7 bytes*/
+#define SYSEX_STORE_BEGIN   0x10	/*Reply: status, sequence in use*/
+#define SYSEX_STORE_BLOCK   0x11	/*Block, packed data, CRC; reply: status, block*/
+#define SYSEX_STORE_COMMIT  0x12	/*Reply: status, new sequence*/
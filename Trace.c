@@ -0,0 +1,42 @@
+/******************************************************************************
+ * Trace.c - Event trace: a ring of the last TRACE_LEN events, each a 16 bit
+ * time stamp in 4 us units, an event code and one argument byte.
+ *
+ * Events are logged through TRACE_EVENT(), which compiles to nothing unless
+ * TRACE is set, so the ring and every log point cost nothing in a release
+ * build. The newest event overwrites the oldest; SYSEX_TRACE_DUMP sends the
+ * ring over MIDI out and sim/tracedump prints it as a timeline. The stamps
+ * wrap every 262 ms, so OS_Tick() logs a slice mark often enough for the
+ * decoder to count the wraps.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "includes.h"
+#include "Trace.h"
+
+#if TRACE
+TRACE_RECORD TraceRing[TRACE_LEN];
+INT8U TraceHead = 0;				/*Next record written, the oldest kept*/
+INT8U TraceHold = FALSE;			/*Set while the ring is being dumped*/
+
+/******************************************************************************
+ * TraceLog(INT8U, INT8U) - Logs an event now. Called from the main loop and
+ * from interrupts, so the record is claimed with interrupts disabled. Events
+ * during a dump are dropped.
+ *****************************************************************************/
+void TraceLog(INT8U Code, INT8U Arg){
+	unsigned short state;
+	TRACE_RECORD *record;
+	if(TraceHold){
+		return;
+	}else{}
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	record = &TraceRing[TraceHead];
+	TraceHead = (TraceHead + 1) & TRACE_MASK;
+	record->Time = (INT16U)(GetTime() >> TRACE_TIME_SHIFT);
+	record->Code = Code;
+	record->Arg = Arg;
+	__set_interrupt_state(state);
+}
+#endif
@@ -0,0 +1,34 @@
+/******************************************************************************
+ * Trace.h - Header for the Trace.c Module
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+void TraceLog(INT8U Code, INT8U Arg);
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#ifndef TRACE
+#define TRACE            0			/*1 keeps the last TRACE_LEN events (4 bytes each)*/
+#endif
+#define TRACE_LEN        32			/*Must be a power of two*/
+#define TRACE_MASK       (TRACE_LEN - 1)
+#define TRACE_TIME_SHIFT 6			/*GetTime() ticks to 4 us, wraps every 262 ms*/
+#define TRACE_MARK_MASK  0x0F		/*A slice mark every 164 ms keeps the wraps countable*/
+
+#if TRACE
+#define TRACE_EVENT(CODE, ARG) TraceLog((CODE), (ARG))
+#else
+#define TRACE_EVENT(CODE, ARG)
+#endif
+
+/*Event codes; a processed MIDI message is logged under its status byte*/
+#define TRACE_NONE       0x00		/*Unused record*/
+#define TRACE_RX_STATUS  0x01		/*Arg: status byte received*/
+#define TRACE_RX_DROP    0x02		/*Arg: byte lost to a full FIFO*/
+#define TRACE_SYNTH      0x03		/*Arg: key played, 0 when silent*/
+#define TRACE_MODE       0x04		/*Arg: mode entered*/
+#define TRACE_SLICE      0x05		/*Arg: slice number*/
+#define TRACE_SLICE_LATE 0x06		/*Arg: slice number of a missed slice*/
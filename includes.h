@@ -21,6 +21,78 @@ typedef struct{
 	INT8U Lower;
 }MIDI_STRUCT;
 
+typedef struct{
+	INT8U Key;
+	INT8U Velocity;
+	INT8U Link;				/*Channel in the high nibble, next slot toward the oldest note in the low*/
+}NOTE_NODE;
+
+typedef struct{
+	INT8U Length;			/*Data bytes that complete the message*/
+	INT8U Update;			/*TRUE if the message changes the output*/
+	void (*Handler)(void);
+}MIDI_HANDLER;
+
+typedef struct{
+	INT16U NextFire;		/*TA0R of the voice's next pulse*/
+	INT16U Period;			/*Zero when the voice is idle*/
+}SYNTH_VOICE;
+
+typedef struct{
+	INT8U Kind;				/*RENDER_KIND() of the type and bank*/
+	INT8U X;				/*Column, or bar length*/
+	union{
+		INT16U Value;		/*Number, character, or bar pattern with the rest in the high byte*/
+		const INT8U *Str;	/*RENDER_STRING only*/
+	}Data;
+}RENDER_JOB;
+
+typedef struct{
+	INT8U Channel;			/*Basic channel, 0 - 15*/
+	INT8U BendRange;		/*Semitones at full bend*/
+	INT8U NotePriority;
+	INT8U DutyCeiling;		/*Percent*/
+	INT8U ThruFilter;		/*THRU_ bits*/
+	INT8U Omni;				/*TRUE plays every channel*/
+	INT8U Spare[10];		/*Pads the block to STORE_BLOCK_LEN; left erased*/
+}STORE_PARAMS;
+
+typedef struct{
+	INT16U Magic;			/*Written last; commits the image*/
+	INT16U Sequence;		/*Newest valid image wins*/
+	INT16U Crc;				/*CRC16-CCITT of the body*/
+	INT16U Spare;
+	STORE_PARAMS Params;	/*Body, uploaded in STORE_BLOCK_LEN blocks*/
+	INT16U Period[128];
+	INT8U OnTime[128];
+}STORE_IMAGE;
+
+typedef struct{
+	INT16U Press;			/*Button bits, see BUTTON_MASK*/
+	INT16U Release;
+	INT16U Repeat;			/*BUTTON_REPEAT_MASK buttons held since an earlier slice*/
+}BUTTON_EVENTS;
+
+typedef struct{
+	void (*Task)(void);
+	INT8U Events;			/*Kernel events that run the task*/
+	INT8U Period;			/*Slices between runs; 0 runs on every event*/
+	INT8U Phase;			/*Slice offset of the first periodic run*/
+}TASK;
+
+typedef struct{
+	INT16U Min;				/*TA1 ticks, saturating at 0xFFFF*/
+	INT16U Max;
+	INT16U Avg;
+	INT16U Overruns;		/*Runs still going when the next slice began*/
+}TASK_STATS;
+
+typedef struct{
+	INT16U Time;			/*GetTime() >> TRACE_TIME_SHIFT*/
+	INT8U Code;				/*TRACE_ event, or the status of a MIDI message*/
+	INT8U Arg;
+}TRACE_RECORD;
+
 /*General Defines*/
 #define TRUE  1
 #define FALSE 0
@@ -33,9 +105,16 @@ typedef struct{
 #define MIDI_MODE	   0
 
 #define SLICE_DIVIDER 5
+#define EVENT_TICK    0x01			/*Kernel events*/
+#define EVENT_MIDI_RX 0x02
+#define NUM_TASKS     7
+#ifndef TASK_TIMING
+#define TASK_TIMING   0			/*1 keeps TaskStats (8 bytes of RAM a task)*/
+#endif
+#define RENDER_SLICE_LIMIT 4		/*WDT ticks into a slice after which the LCD waits*/
 #define NRM_CLK 40
 #define NRM_FACTOR 100
-#define SCALE(IN,FACTOR,BOUND) (IN*FACTOR)/BOUND
+#define SCALE(IN,FACTOR,BOUND) ScaleQ8((IN), Q8(FACTOR, BOUND))	/*See Fixed.h*/
 
 /*Pin Defines*/
 #define MIDI_RX_PIN			BIT1	/*P1.1*/
@@ -59,28 +138,53 @@ typedef struct{
 #define MAX_CCR0	    0xFFFF
 #define BACKLIGHT_PWM	0xFFF
 
-/*ADC Index Defines*/
-#define TOP_CHANNEL     0x02
+/*ADC Index Defines; each sequence converts A4 down to A0*/
+#define ADC_SEQ_LEN     5
+#define ADC_SEQUENCES   1			/*Sequences in the DTC ring*/
+#define ADC_RING_LEN    (ADC_SEQ_LEN * ADC_SEQUENCES)
+#define ADC_POTS        2
 #define FREQUENCY_POT	0x00
 #define ON_TIME_POT	    0x01
 
-/*Button Defines*/
-#define BACKLIGHT_BUTTON()   !(P2IN & BIT0)
-#define MODE_BUTTON()		 !(P1IN & BIT0)
+/*ADC Filter Defines; the filter runs on the ring sum scaled to 15 bits*/
+#define ADC_SUM_SHIFT   5			/*10 bit samples * ADC_SEQUENCES to 15 bits*/
+#define ADC_IIR_SHIFT   2			/*~40 ms time constant at one update a slice*/
+#define ADC_STEP_SHIFT  8			/*15 bits to the 7 bit output*/
+#define ADC_STEP        (1 << ADC_STEP_SHIFT)
+#define ADC_HYSTERESIS  64			/*A quarter step past the step edge*/
+
+/*Button Defines; P1 pins in the low byte, P2 pins in the high byte*/
+#define BUTTON_MODE         ((INT16U)MODE_SW_PIN)
+#define BUTTON_BACKLIGHT    ((INT16U)BCKLIGHT_SW_PIN << 8)
+#define BUTTON_MASK         (BUTTON_MODE | BUTTON_BACKLIGHT)
+#define BUTTON_REPEAT_MASK  BUTTON_BACKLIGHT	/*Buttons that repeat while held*/
+#define READ_BUTTONS()      (~(P1IN | ((INT16U)P2IN << 8)) & BUTTON_MASK)
 
 /*Button Task Defines*/
-#define DEBOUNCE_TIME       0.2
-#define SAMPLE_FREQUENCY    100
-#define MAXIMUM             (DEBOUNCE_TIME * SAMPLE_FREQUENCY)
+#define BACKLIGHT_STEP      128
 
 
 /*Module Includes*/
 #include "MIDI.h"
 #include "LCD.h"
-
-extern const INT8U *NoteLookup[128];
+#include "Synth.h"
+#include "SysEx.h"
+#include "Song.h"
+#include "Store.h"
+#include "Clock.h"
+#include "Fixed.h"
+#include "Burst.h"
+#include "Trace.h"
+
+extern const INT8U *const NoteLookup[128];
 extern const INT16U PeriodLookup[128];
 extern const INT8U OnTimeLookup[128];
+extern const INT16U *PeriodTable;
+extern const INT8U *OnTimeTable;
+extern const INT16U *const SongTable[];
+extern const INT8U SongCount;
+
+INT32U GetTime(void);
 
 
 
@@ -22,16 +22,22 @@ static void SPIInit(void);
 
 static void ManualModeTask(void);
 static void ButtonHandlerTask(void);
+static void ScanButtons(BUTTON_EVENTS *Events);
 static void UpdateLCDTask(void);
-static void WaitForSlice(void);
+static void RenderLCDTask(void);
+static INT8U WaitForEvents(void);
+static void InitTasks(void);
+static void DispatchTasks(INT8U Events);
+static void RunTask(INT8U Index);
 
 static void ModeChange(void);
 static void UpdateTimer(INT8U Frequency, INT8U OnTime);
-static void SampleADC(INT16U *FrequenyPtr, INT16U *OnTimePtr);
-static void ByteToString(INT16U Byte, INT8U* Str);
+static void FilterADCTask(void);
+static INT8U Hysteresis(INT16U Filtered, INT8U Last);
+static void QueueMidiScreen(void);
 
 
-const INT8U* NoteLookup[128] =
+const INT8U *const NoteLookup[128] =
 {"OFF ","C0# ","D0 ","D0# ","E0 ","F0 ","F0# ","G0 ","G0#","A0 ","A0#","B0 ",
  "C1 ","C1# ","D1 ","D1# ","E1 ","F1 ","F1# ","G1 ","G1#","A1 ","A1#","B1 ",
  "C2 ","C2# ","D2 ","D2# ","E2 ","F2 ","F2# ","G2 ","G2#","A2 ","A2#","B2 ",
@@ -44,10 +50,12 @@ const INT8U* NoteLookup[128] =
  "C9 ","C9# ","D9 ","D9# ","E9 ","F9 ","F9# ","G9 ","G9#","A9 ","A9#","B9 ",
  "C10","C10#","D10","D10#","E10","F10","F10#","G10"};
 
+/*TA0 periods; keys below SYNTH_SLOW_KEYS are in SMCLK/8 ticks, the rest in
+ *SMCLK/4 ticks. Keys below 23 need more than 16 bits even at SMCLK/8.*/
 const INT16U PeriodLookup[128] =
 {0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,
- 0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,
  0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,0x00 ,64792,
+ 61156,57724,54484,51426,48540,45815,43244,40817,38526,36364,34323,64792,
  61156,57724,54484,51426,48540,45815,43244,40817,38526,36364,34323,32396,
  30578,28862,27242,25713,24270,22908,21622,20408,19263,18182,17161,16198,
  15289,14431,13621,12856,12135,11454,10811,10204,9632 ,9091 ,8581 ,8099 ,
@@ -69,250 +77,387 @@ const INT8U OnTimeLookup[128]=
 
 static const INT8U MidiStr[]      = "Midi Mode";
 static const INT8U ManualStr[]    = "Manual Mode";
+static const INT8U BurstStr[]     = "Burst";
 static const INT8U FrequencyStr[] = "Frequency:---";
 static const INT8U OnTimeStr[]    = "On Time:---";
 
-static volatile INT16U ADCDataBuffer[TOP_CHANNEL];
+/*Task table in priority order, first runs first; Period and Phase are in
+ *slices, a Period of 0 runs the task on every pass that posts one of its
+ *Events.*/
+static const TASK TaskTable[NUM_TASKS] = {
+/*   Task                 Events                        Period Phase*/
+	{HandleMidiFrameTask, EVENT_MIDI_RX,                0,     0},
+	{SongTask,            EVENT_TICK,                   1,     0},
+	{FilterADCTask,       EVENT_TICK,                   1,     0},
+	{ManualModeTask,      EVENT_TICK,                   3,     0},
+	{ButtonHandlerTask,   EVENT_TICK,                   1,     0},
+	{UpdateLCDTask,       EVENT_TICK,                   4,     1},
+	{RenderLCDTask,       (EVENT_TICK | EVENT_MIDI_RX), 0,     0}
+};
+static INT8U TaskCountdown[NUM_TASKS];	/*Slices until the next periodic run*/
+#if TASK_TIMING
+TASK_STATS TaskStats[NUM_TASKS];		/*Execution times in TA1 ticks*/
+#endif
+INT16U MissedSlices = 0;				/*Ticks posted while one was pending*/
+static volatile INT16U TimeHigh = 0;	/*TA1 rollovers*/
+
+static volatile INT16U ADCDataBuffer[ADC_RING_LEN];	/*DTC ring, A4 first*/
+static INT16U PotFiltered[ADC_POTS];	/*IIR output, 15 bits*/
+static INT8U PotValue[ADC_POTS];		/*7 bit output after hysteresis*/
 
 INT8U Mode = MIDI_MODE;
-static INT8U SliceCount = 0;
-static INT8U Tick;
-static INT8U LCDAddrX = 0;
-static INT8U LCDAddrY = 0;
+static INT8U BurstPage = FALSE;		/*Manual mode pots set the burst times*/
+static volatile INT8U SliceCount = 0;
+volatile INT8U KernelEvents = 0;	/*EVENT_ bits posted by ISRs*/
+static volatile INT8U SliceNumber = 0;		/*Counts slices for per-slice statistics*/
+#if TASK_TIMING
+INT32U RenderMaxCost = 0;			/*Worst LCD render time in one slice, TA1 ticks*/
+#endif
 
-INT16U Frequency;
-INT16U OnTime;
+INT8U Frequency;
+INT8U OnTime;
+extern INT8U BurstOn;
+extern INT8U BurstOff;
 
-extern INT8U MidiRxFlag;
+static INT16U ButtonState = 0;		/*Debounced buttons, 1 is pressed*/
+static INT16U ButtonCount0 = 0xFFFF;	/*Vertical counter, bit 0 of each button*/
+static INT16U ButtonCount1 = 0xFFFF;	/*Bit 1*/
 
 void main(void){
   SystemInit();
+	InitTasks();
 	FOREVER(){
-		HandleMidiFrameTask();
-		ManualModeTask();
-		ButtonHandlerTask();
-		UpdateLCDTask();
-		WaitForSlice();
+		DispatchTasks(WaitForEvents());
+	}
+}
+/******************************************************************************
+ * InitTasks() - Loads each periodic task's phase offset.
+ *****************************************************************************/
+void InitTasks(void){
+	INT8U i;
+	for(i=0;i<NUM_TASKS;i++){
+		TaskCountdown[i] = TaskTable[i].Phase + 1;
+#if TASK_TIMING
+		TaskStats[i].Min = 0xFFFF;
+#endif
+	}
+}
+/******************************************************************************
+ * DispatchTasks(INT8U) - Runs, in table order, every task whose events were
+ * posted; periodic tasks also wait out their period in slices.
+ *****************************************************************************/
+void DispatchTasks(INT8U Events){
+	INT8U i;
+	const TASK *task;
+	for(i=0;i<NUM_TASKS;i++){
+		task = &TaskTable[i];
+		if(Events & task->Events){
+			if(task->Period == 0){
+				RunTask(i);
+			}else if(Events & EVENT_TICK){
+				TaskCountdown[i]--;
+				if(TaskCountdown[i] == 0){
+					TaskCountdown[i] = task->Period;
+					RunTask(i);
+				}else{}
+			}else{}
+		}else{}
+	}
+}
+/******************************************************************************
+ * RunTask(INT8U) - Runs a task and, with TASK_TIMING, records its execution
+ * time. A task that is still running when the next slice starts has overrun
+ * its deadline.
+ *****************************************************************************/
+void RunTask(INT8U Index){
+#if TASK_TIMING
+	TASK_STATS *stats = &TaskStats[Index];
+	INT8U slice = SliceNumber;
+	INT32U start;
+	INT32U elapsed;
+	INT16U ticks;
+
+	start = GetTime();
+	TaskTable[Index].Task();
+	elapsed = GetTime() - start;
+	ticks = (elapsed > 0xFFFF) ? 0xFFFF : (INT16U)elapsed;
+	if(ticks < stats->Min){
+		stats->Min = ticks;
+	}else{}
+	if(ticks > stats->Max){
+		stats->Max = ticks;
+	}else{}
+	if(ticks > stats->Avg){					/*Average over ~8 runs*/
+		stats->Avg += (ticks - stats->Avg) >> 3;
+	}else{
+		stats->Avg -= (stats->Avg - ticks) >> 3;
 	}
+	if(slice != SliceNumber){
+		stats->Overruns++;
+	}else{}
+#else
+	TaskTable[Index].Task();
+#endif
+}
+/******************************************************************************
+ * GetTime() - 32 bit free running time in TA1 ticks (62.5 ns); TA1 counts the
+ * low word and its rollover interrupt the high word. Safe to call from ISRs.
+ *****************************************************************************/
+INT32U GetTime(void){
+	INT16U high;
+	INT16U low;
+	unsigned short state = __get_interrupt_state();
+	__disable_interrupt();
+	high = TimeHigh;
+	low = TA1R;
+	if((TA1CCTL0 & CCIFG) && (low < 0x8000)){	/*Rollover not yet counted*/
+		high++;
+	}else{}
+	__set_interrupt_state(state);
+	return ((INT32U)high << 16) | low;
 }
 /******************************************************************************
  * ModeChange() - Facilitates the transition between MIDI and Manual mode.
  *****************************************************************************/
 void ModeChange(void){
-	INT8U velstr[3];
 	if(Mode == MIDI_MODE){
-		ClearBank(0);				/*Init LCD for Manual Mode*/
-		LCDAddrX = 0;
-		LCDAddrY = 0;
-		SetAddr(LCDAddrX, LCDAddrY);
-		WriteStringToLCD(ManualStr);
-		LCDAddrX = 60;
-		LCDAddrY = 2;
-		SetAddr(LCDAddrX, LCDAddrY);
-		WriteStringToLCD(NoteLookup[Frequency]);
-		LCDAddrX = 0;
-		LCDAddrY = 3;
-		SetAddr(LCDAddrX, LCDAddrY);
-		WriteBlockToLCD(BLOCK, SCALE(Frequency, LCD5110_LENGTH, 128));
-		LCDAddrX = 47;
-		LCDAddrY = 4;
-		SetAddr(LCDAddrX, LCDAddrY);
-		ByteToString(SCALE(OnTime,NRM_FACTOR,NRM_CLK), velstr);
-		WriteStringToLCD(velstr);
-		LCDAddrX = 0;
-		LCDAddrY = 5;
-		SetAddr(LCDAddrX, LCDAddrY);
-		WriteBlockToLCD(BLOCK, SCALE(OnTime, LCD5110_LENGTH,128));
+		QueueClearBank(0);			/*Init LCD for Manual Mode*/
+		QueueString(0, 0, ManualStr);
+		QueueString(60, 2, NoteLookup[Frequency]);
+		QueueBar(3, BLOCK, SCALE(Frequency, LCD5110_LENGTH, 128));
+		QueueNumber(47, 4, SCALE(OnTime,NRM_FACTOR,NRM_CLK));
+		QueueBar(5, BLOCK, SCALE(OnTime, LCD5110_LENGTH,128));
 
+		ClockStop();				/*Manual output is never gated*/
+		BurstStop();
+		BurstPage = FALSE;
 		Mode = MANUAL_MODE;
 	}else{
-		ClearLCD(); 				/*Init LCD for Midi Mode*/
-		LCDAddrX = 0;
-		LCDAddrY = 0;
-		SetAddr(LCDAddrX,LCDAddrY);
-		WriteStringToLCD(MidiStr);
-		LCDAddrX = 0;
-		LCDAddrY = 1;
-		SetAddr(LCDAddrX,LCDAddrY);
-		WriteBlockToLCD(UNDERLINE,LCD5110_LENGTH);
-		LCDAddrX = 0;
-		LCDAddrY = 2;
-		SetAddr(LCDAddrX,LCDAddrY);
-		WriteStringToLCD(FrequencyStr);
-		LCDAddrX = 0;
-		LCDAddrY = 4;
-		SetAddr(LCDAddrX,LCDAddrY);
-		WriteStringToLCD(OnTimeStr);
-		LCDAddrX = 65;
-		LCDAddrY = 4;
-		SetAddr(LCDAddrX,LCDAddrY);
-		WriteCharToLCD(0x80);
-		WriteCharToLCD('s');
+		QueueClear(); 				/*Init LCD for Midi Mode*/
+		QueueMidiScreen();
 
+		BurstStop();
+		BurstPage = FALSE;
 		ClearNoteBuffer();			/*Init data and hardware for Midi Mode*/
-		TA0CCR0  = 0;
-		TA0CCR1  = 0;
-	    P2OUT &= ~ENABLE_OUT_PIN;
+		SynthStop();
 		Mode = MIDI_MODE;
 	}
+	TRACE_EVENT(TRACE_MODE, Mode);
 }
 /******************************************************************************
- * ByteToString(INT16U, INT8U*) - Takes in an INT16U word and loads a string
- * representation in to the given pointer address.
+ * QueueMidiScreen() - Queues the static text of the Midi mode screen.
  *****************************************************************************/
-void ByteToString(INT16U Byte, INT8U* Str){
-		Str[0] = (Byte / 100) + 0x30;
-		Str[1] = ((Byte % 100) / 10) + 0x30;
-		Str[2] = (Byte % 10) + 0x30;
-		Str[3] = 0x00;
+void QueueMidiScreen(void){
+	QueueString(0, 0, MidiStr);
+	QueueGauge(1, THICKLINE, UNDERLINE, SCALE(SynthDutyLevel(), LCD5110_LENGTH, 128));
+	QueueString(0, 2, FrequencyStr);
+	QueueString(0, 4, OnTimeStr);
+	QueueChar(65, 4, MICRO);
+	QueueChar(71, 4, 's');
 }
 /******************************************************************************
- * ButtonHandlerTask() - Polls and processes user button input.
+ * ButtonHandlerTask() - Polls and processes user button input. Pressing the
+ * backlight button while the mode button is held starts or stops the stored
+ * song in Midi mode and switches the pots between the output and the burst
+ * times in Manual mode; the mode does not change on that release. Holding the
+ * backlight button ramps the back light.
  *****************************************************************************/
 void ButtonHandlerTask(void){
-	static INT8U ModeIntegrator = 0;
-	static INT8U BackLightIntegrator = 0;
-	static INT8U ModeButtonState = FALSE;
-	static INT8U BackLightButtonState = FALSE;
-	static INT8U ModeButton;
-	static INT8U BackLightButton;
-
-	if(!MODE_BUTTON()){						    /*Mode button integrator*/
-		if(ModeIntegrator > 0){
-			ModeIntegrator--;
-		}else{}
-	}else if(ModeIntegrator < MAXIMUM){
-		ModeIntegrator++;
-	}else{}
+	static INT8U ModeChord = FALSE;				/*Mode button used with backlight*/
+	BUTTON_EVENTS events;
 
-	if(ModeIntegrator == 0){					/*Mode button triggering*/
-		ModeButton = FALSE;
-	}else if(ModeIntegrator >= MAXIMUM){
-		ModeButton = TRUE;
-	}else{}
-
-	if(ModeButtonState != ModeButton){		    /*Mode button Edge detection*/
-		ModeButtonState = ModeButton;
-		if(ModeButton == FALSE){ 				/*Falling Edge*/
+	ScanButtons(&events);
+	if(events.Release & BUTTON_MODE){
+		if(ModeChord){
+			ModeChord = FALSE;
+		}else{
 			ModeChange();
-		}else{}
+		}
 	}else{}
-
-	if(!BACKLIGHT_BUTTON()){					/*Backlight button integrator*/
-		if(BackLightIntegrator > 0){
-			BackLightIntegrator--;
-		}else{}
-	}else if(BackLightIntegrator < MAXIMUM){
-		BackLightIntegrator++;
+	if((events.Press & BUTTON_BACKLIGHT) && (ButtonState & BUTTON_MODE)){
+		ModeChord = TRUE;
+		if(Mode == MIDI_MODE){					/*Mode held: start/stop song*/
+			SongToggle();
+		}else{									/*or flip the burst page*/
+			BurstPage = !BurstPage;
+			QueueClearBank(0);
+			if(BurstPage){
+				QueueString(0, 0, BurstStr);
+				QueueNumber(36, 0, BurstOn);
+				QueueChar(54, 0, '/');
+				QueueNumber(60, 0, (INT16U)BurstOff << BURST_OFF_SHIFT);
+			}else{
+				QueueString(0, 0, ManualStr);
+			}
+		}
 	}else{}
-
-	if(BackLightIntegrator == 0){				/*Backlight button triggering*/
-		BackLightButton = FALSE;
-	}else if(BackLightIntegrator >= MAXIMUM){
-		BackLightButton = TRUE;
+	if(events.Repeat & BUTTON_BACKLIGHT){
+		TA1CCR1 += BACKLIGHT_STEP;
 	}else{}
-
-	if(BackLightButtonState != BackLightButton){/*Backlight button edge detection*/
-		BackLightButtonState = BackLightButton;
-		if(ModeButton == FALSE){
-		}else{}
-	}else{
-		if(BackLightButton){
-			TA1CCR1 += 128;
-		}else{}
-	}
-
 }
-
 /******************************************************************************
- * ManualModeTask() - Sample the analog user inputs and update the timers
- * accordingly.
+ * ScanButtons(BUTTON_EVENTS *) - Debounces every button at once with a two
+ * bit vertical counter per button: a button whose input differs from its
+ * debounced state for four samples in a row changes state, and any sample
+ * that agrees resets its count. The cost is the same for any number of
+ * buttons on P1 and P2. Each repeat button posts a repeat on every slice it
+ * is still held after the one it was pressed in, independent of the others.
+ *****************************************************************************/
+void ScanButtons(BUTTON_EVENTS *Events){
+	INT16U changed = ButtonState ^ READ_BUTTONS();
+	ButtonCount0 = ~(ButtonCount0 & changed);
+	ButtonCount1 = ButtonCount0 ^ (ButtonCount1 & changed);
+	changed &= ButtonCount0 & ButtonCount1;		/*Count rolled over*/
+	ButtonState ^= changed;
+	Events->Press = ButtonState & changed;
+	Events->Release = ~ButtonState & changed;
+	Events->Repeat = ButtonState & ~changed & BUTTON_REPEAT_MASK;
+}
+/******************************************************************************
+ * ManualModeTask() - Update the timers from the filtered analog user inputs.
+ * On the burst page the pots set the burst on and off times instead and the
+ * output keeps its rate and width.
  * Period = 30 ms
  *****************************************************************************/
 void ManualModeTask(void){
-	static INT8U PassCount = 0;
-	if(Mode == MANUAL_MODE){
-		PassCount++;
-		if(PassCount >= 3){
-			PassCount = 0;
-			SampleADC(&Frequency,&OnTime);
-			UpdateTimer(Frequency, OnTime);
-		}else{}
+	if((Mode == MANUAL_MODE) && BurstPage){
+		BurstSetOn(PotValue[FREQUENCY_POT]);
+		BurstSetOff(PotValue[ON_TIME_POT]);
+	}else if(Mode == MANUAL_MODE){
+		Frequency = PotValue[FREQUENCY_POT];
+		OnTime = PotValue[ON_TIME_POT];
+		UpdateTimer(Frequency, OnTime);
 	}else{}		/*In Midi mode*/
 }
 /******************************************************************************
- * WaitForSlice()
- * -MIDI mode waits for either the system tick or a received Midi byte.
- * -Manual mode waits for system tick.
- * Period = 10 ms to 256 us
+ * WaitForEvents() - Sleeps in LPM0 until an ISR posts a kernel event, then
+ * returns and clears the posted events. A received MIDI byte only wakes the
+ * MIDI task; the slice tick runs the periodic tasks.
+ * Period = 10 ms to 320 us
  *****************************************************************************/
-void WaitForSlice(void){
-	if(Mode == MIDI_MODE){
-		while(!MidiRxFlag && !Tick){}
-		Tick = FALSE;
-	}else{
-		while(!Tick){}
-		Tick = FALSE;
+INT8U WaitForEvents(void){
+	INT8U events;
+	__disable_interrupt();
+	while(!KernelEvents){
+		__bis_SR_register(LPM0_bits | GIE);	/*Sleep with interrupts enabled*/
+		__disable_interrupt();
 	}
+	events = KernelEvents;
+	KernelEvents = 0;
+	__enable_interrupt();
+	return events;
 }
 /******************************************************************************
- * UpdateLCDTask() - Update the display with the current value of the output
- * time and the mode of the system.
+ * UpdateLCDTask() - Queue display updates for the current value of the output
+ * time, the duty budget, the burst times on the burst page and the mode of
+ * the system.
  * Period = 40 ms
  *****************************************************************************/
 void UpdateLCDTask(void){
-	static INT8U PassCount = 0;
 	static INT8U CurrentFrequency = 0;
 	static INT8U CurrentOnTime = 0;
-	INT8U VelString[4];
+	static INT8U CurrentDuty = 0;
+	static INT8U CurrentBurstOn = 0;
+	static INT8U CurrentBurstOff = 0;
+	INT8U duty = SCALE(SynthDutyLevel(), LCD5110_LENGTH, 128);
 
-	PassCount++;
-	if(PassCount >= 4){
-		PassCount = 0;
-		if(CurrentFrequency != Frequency){
-			CurrentFrequency = Frequency;
-			LCDAddrX = 60;
-			LCDAddrY = 2;
-			SetAddr(LCDAddrX, LCDAddrY);
-			WriteStringToLCD(NoteLookup[CurrentFrequency]);
-			LCDAddrX = 0;
-			LCDAddrY = 3;
-			SetAddr(LCDAddrX, LCDAddrY);
-			WriteBlockToLCD(BLOCK, SCALE(CurrentFrequency, LCD5110_LENGTH, 128));
-		}else{}
-		if(CurrentOnTime != OnTime){
-			CurrentOnTime = OnTime;
-			LCDAddrX = 47;
-			LCDAddrY = 4;
-			SetAddr(LCDAddrX, LCDAddrY);
-			ByteToString(SCALE(CurrentOnTime,NRM_FACTOR,NRM_CLK), VelString);
-			WriteStringToLCD(VelString);
-			LCDAddrX = 0;
-			LCDAddrY = 5;
-			SetAddr(LCDAddrX, LCDAddrY);
-			WriteBlockToLCD(BLOCK, SCALE(CurrentOnTime, LCD5110_LENGTH,128));
-		}else{}
+	if(CurrentFrequency != Frequency){
+		CurrentFrequency = Frequency;
+		QueueString(60, 2, NoteLookup[CurrentFrequency]);
+		QueueBar(3, BLOCK, SCALE(CurrentFrequency, LCD5110_LENGTH, 128));
+	}else{}
+	if(CurrentOnTime != OnTime){
+		CurrentOnTime = OnTime;
+		QueueNumber(47, 4, SCALE(CurrentOnTime,NRM_FACTOR,NRM_CLK));
+		QueueBar(5, BLOCK, SCALE(CurrentOnTime, LCD5110_LENGTH,128));
+	}else{}
+	if(CurrentDuty != duty){			/*Duty budget on the underline*/
+		CurrentDuty = duty;
+		QueueGauge(1, THICKLINE, UNDERLINE, CurrentDuty);
+	}else{}
+	if(BurstPage && ((CurrentBurstOn != BurstOn) || (CurrentBurstOff != BurstOff))){
+		CurrentBurstOn = BurstOn;
+		CurrentBurstOff = BurstOff;
+		QueueNumber(36, 0, CurrentBurstOn);
+		QueueNumber(60, 0, (INT16U)CurrentBurstOff << BURST_OFF_SHIFT);
+	}else{}
+}
+/******************************************************************************
+ * RenderLCDTask() - Draws queued display jobs while slice time remains. Stops
+ * when RENDER_SLICE_LIMIT WDT ticks of the slice have passed or any kernel
+ * event is posted, so display work only ever delays pixels.
+ * With TASK_TIMING, RenderMaxCost records the worst render time spent in a
+ * single slice.
+ *****************************************************************************/
+void RenderLCDTask(void){
+#if TASK_TIMING
+	static INT8U RenderSlice = 0;
+	static INT32U SliceCost = 0;
+	INT16U start;
+#endif
+	INT8U busy = TRUE;
+
+#if TASK_TIMING
+	if(RenderSlice != SliceNumber){
+		RenderSlice = SliceNumber;
+		SliceCost = 0;
+	}else{}
+#endif
+	while(busy && (SliceCount < RENDER_SLICE_LIMIT) && !KernelEvents){
+#if TASK_TIMING
+		start = TA1R;
+		busy = RenderJob();
+		SliceCost += (INT16U)(TA1R - start);
+#else
+		busy = RenderJob();
+#endif
 	}
+#if TASK_TIMING
+	if(SliceCost > RenderMaxCost){
+		RenderMaxCost = SliceCost;
+	}else{}
+#endif
 }
 /******************************************************************************
- * SampleADC(INT16U *,INT16U *) - Configures hardware module outputs, and user
- * input buttons.
+ * FilterADCTask() - Decimates the DTC ring into the pot values. The samples
+ * of each pot in the ring are summed (box filter), run through a first order
+ * IIR filter at 15 bits and cut to 7 bits with hysteresis. Each word of the
+ * ring is whole whenever it is read, so the DTC is never waited on.
+ * Period = 10 ms
  *****************************************************************************/
-void SampleADC(INT16U *FrequencyPtr,INT16U *OnTimePtr){
-	ADC10CTL0 &= ~ENC;					/*Start ADC sampling*/
-	while(ADC10CTL1 & BUSY){};
-	ADC10SA = (INT16U)ADCDataBuffer;	/*Set DMA destination address*/
-	ADC10CTL0 |= (ENC | ADC10SC);		/*Disable ADC*/
-	*FrequencyPtr = (INT8U)(0x007F & (ADCDataBuffer[FREQUENCY_POT] >> 3));  /*Capture and downsample to 7 bits*/
-	*OnTimePtr = (INT8U)(0x007F & (ADCDataBuffer[ON_TIME_POT] >> 3));		/*Capture and downsample to 7 bits*/
+void FilterADCTask(void){
+	INT8U pot;
+	INT8U i;
+	INT16U sum;
+	for(pot=0;pot<ADC_POTS;pot++){
+		sum = 0;
+		for(i=pot;i<ADC_RING_LEN;i+=ADC_SEQ_LEN){
+			sum += ADCDataBuffer[i];
+		}
+		sum <<= ADC_SUM_SHIFT;
+		PotFiltered[pot] += (INT16S)(sum - PotFiltered[pot]) >> ADC_IIR_SHIFT;
+		PotValue[pot] = Hysteresis(PotFiltered[pot], PotValue[pot]);
+	}
+}
+/******************************************************************************
+ * Hysteresis(INT16U, INT8U) - The 7 bit step of a filtered value. The last
+ * step is kept until the value is ADC_HYSTERESIS beyond either of its edges,
+ * so noise on a step edge does not flicker the output.
+ *****************************************************************************/
+INT8U Hysteresis(INT16U Filtered, INT8U Last){
+	INT16U low = (INT16U)Last << ADC_STEP_SHIFT;
+	if((Filtered + ADC_HYSTERESIS < low) || (Filtered >= low + ADC_STEP + ADC_HYSTERESIS)){
+		return (INT8U)(Filtered >> ADC_STEP_SHIFT);
+	}else{
+		return Last;
+	}
 }
 /******************************************************************************
  * UpdateTimer(INT8U, INT8U) - Update the enable out timer according to
  * current Frequency and On Time configured by the user.
  *****************************************************************************/
 void UpdateTimer(INT8U Frequency, INT8U OnTime){
-	TA0CCR0 = PeriodLookup[Frequency];
-	TA0CCR1 = OnTimeLookup[OnTime];
+	SynthSetMono(SynthPeriod(Frequency), OnTimeTable[OnTime]);
 }
 /******************************************************************************
  * SystemInit() - Initialize system.
@@ -326,47 +471,24 @@ void SystemInit(void){
 	UARTInit();
 	ADCInit();
 	TimersInit();
+	StoreInit();			/*Uploaded tables and parameters*/
 	SPIInit();
 	InitLCD();
 
 	__bis_SR_register(GIE);	/*Enable global interrupts*/
-	LCDAddrX = 0;		  	/*Draw initial LCD*/
-	LCDAddrY = 1;
-	SetAddr(LCDAddrX,LCDAddrY);
-	WriteBlockToLCD(UNDERLINE,LCD5110_LENGTH);
-	LCDAddrX = 0;
-	LCDAddrY = 0;
-	SetAddr(LCDAddrX,LCDAddrY);
-	WriteStringToLCD(MidiStr);
-	LCDAddrX = 0;
-	LCDAddrY = 2;
-	SetAddr(LCDAddrX,LCDAddrY);
-	WriteStringToLCD(FrequencyStr);
-	LCDAddrX = 0;
-	LCDAddrY = 4;
-	SetAddr(LCDAddrX,LCDAddrY);
-	WriteStringToLCD(OnTimeStr);
-	LCDAddrX = 65;
-	LCDAddrY = 4;
-	SetAddr(LCDAddrX,LCDAddrY);
-	WriteCharToLCD(0x80);
-	WriteCharToLCD('s');
+	QueueMidiScreen();		/*Draw initial LCD*/
 }
 /******************************************************************************
  * TimersInit() - Configures Timers;
- * TA0 is used to synthesize the enable output signal
- * TA1 is used to control the intensity of the LCD back light
+ * TA0 is used to synthesize the enable output signal (see Synth.c)
+ * TA1 is used to control the intensity of the LCD back light and, with its
+ * rollover interrupt, as the free running time base of GetTime()
  * WDT is configured in interval mode to generate the time slice tick.
  *****************************************************************************/
 void TimersInit(void){
-    TA0CTL   = (TASSEL_2 | ID_2 | MC_1);
-    TA0CCTL0 = (CM_0 | CCIS_0 | OUTMOD_4);
-    TA0CCTL1 = (CM_0 | CCIS_0 | SCS | CAP | OUTMOD_7);
-	TA0CCR0  = 0;
-	TA0CCR1  = 0;
-    P2OUT &= ~ENABLE_OUT_PIN;
+    SynthInit();
     TA1CTL   = (TASSEL_2 | MC_1);
-    TA1CCTL0 = (CM_0 | CCIS_0 | OUTMOD_4);
+    TA1CCTL0 = (CM_0 | CCIS_0 | OUTMOD_4 | CCIE);
     TA1CCTL1 = (CM_0 | CCIS_0 | SCS | CAP | OUTMOD_3);
 	TA1CCR0  = 65535;
 	TA1CCR1  = 30000;
@@ -392,14 +514,18 @@ void GPIOInit(void){
     P2OUT |= BCKLIGHT_SW_PIN;
 }
 /******************************************************************************
- * ADCInit() - Configures the ADC10 module to read from the ADC input pins in
- * single sequence one-shot mode.
+ * ADCInit() - Configures the ADC10 module to convert the ADC input pins in
+ * repeat sequence mode. The DTC fills ADCDataBuffer as a ring in the
+ * background for FilterADCTask().
  *****************************************************************************/
 void ADCInit(void){
-	ADC10CTL1  = (INCH_4 | CONSEQ_1);
+	ADC10CTL1  = (INCH_4 | CONSEQ_3);
 	ADC10CTL0  = (ADC10ON | MSC | ADC10SHT_3 | ADC10SR);
 	ADC10AE0  |= (FREQUENCY_POT_PIN | ON_TIME_POT_PIN);
-	ADC10DTC1 |=  TOP_CHANNEL;
+	ADC10DTC0  = ADC10CT;					/*Continuous transfer*/
+	ADC10DTC1  = ADC_RING_LEN;
+	ADC10SA    = (INT16U)ADCDataBuffer;		/*Arms the DTC*/
+	ADC10CTL0 |= (ENC | ADC10SC);
 }
 /******************************************************************************
  * UARTInit() - Configures the USCI A0 module in UART mode with baud rate of
@@ -427,13 +553,34 @@ void SPIInit(void){
  * OS_Tick() - Serves as the OS tick for the time slice kernel.
  * The ISR is called by the WatchDogTimer ISR configured as a 2 ms interval
  * timer. This 2 ms period is software divided to 10 ms that serves as the
- * slice period.
+ * slice period; each slice posts EVENT_TICK and wakes the kernel. The duty
+ * limiter is run on every 2 ms tick. Missed slices and every 16th slice are
+ * traced.
  *****************************************************************************/
 #pragma vector=WDT_VECTOR
 __interrupt void OS_Tick(void){
+	SynthDutyTick();
 	SliceCount++;
 	if(SliceCount >= SLICE_DIVIDER){
-		Tick = TRUE;
+		if(KernelEvents & EVENT_TICK){		/*Last slice not yet dispatched*/
+			MissedSlices++;
+			TRACE_EVENT(TRACE_SLICE_LATE, SliceNumber);
+		}else{}
+		KernelEvents |= EVENT_TICK;
 		SliceCount = 0;
+		SliceNumber++;
+#if TRACE
+		if((SliceNumber & TRACE_MARK_MASK) == 0){
+			TraceLog(TRACE_SLICE, SliceNumber);
+		}else{}
+#endif
+		__bic_SR_register_on_exit(LPM0_bits);
 	}else{}
 }
+/******************************************************************************
+ * TimeRollover() - TA1 CCR0 Interrupt, extends TA1R to the 32 bit GetTime().
+ *****************************************************************************/
+#pragma vector=TIMER1_A0_VECTOR
+__interrupt void TimeRollover(void){
+	TimeHigh++;
+}
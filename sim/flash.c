@@ -0,0 +1,81 @@
+/******************************************************************************
+ * flash.c - Virtual flash controller for the two store segments.
+ *
+ * The firmware's FLASH_SEGMENT() points into SimFlash. Every FCTL1 write
+ * first settles the operation the previous FCTL1 value started: after ERASE
+ * the segment that took the dummy write is erased, after WRT the programmed
+ * bytes can only have cleared bits. Both take their datasheet time with the
+ * CPU held, so interrupts pend and UART bytes can be lost as on the part.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "sim.h"
+#include <string.h>
+
+#define FLASH_SEGMENTS   2
+#define FLASH_SEG_LEN    512
+#define FLASH_ERASE_CYC  (4819ULL * 40)	/*tFTG cycles at 16 MHz / 40*/
+#define FLASH_BYTE_CYC   (30ULL * 40)
+
+uint8_t SimFlash[FLASH_SEGMENTS * FLASH_SEG_LEN];
+static uint8_t Shadow[FLASH_SEGMENTS * FLASH_SEG_LEN];	/*Contents before the operation*/
+
+/******************************************************************************
+ * FlashReset() - Erased flash.
+ *****************************************************************************/
+void FlashReset(void){
+	memset(SimFlash, 0xFF, sizeof(SimFlash));
+	memcpy(Shadow, SimFlash, sizeof(SimFlash));
+}
+/******************************************************************************
+ * FlashLoad(const char *), FlashSave(const char *) - Keep the segments in a
+ * file between runs. A missing file leaves the flash erased.
+ *****************************************************************************/
+void FlashLoad(const char *Path){
+	FILE *f = fopen(Path, "rb");
+	if(f){
+		if(fread(SimFlash, 1, sizeof(SimFlash), f) != sizeof(SimFlash)){
+			fprintf(stderr, "%s: short flash image, rest erased\n", Path);
+		}else{}
+		fclose(f);
+	}else{}
+	memcpy(Shadow, SimFlash, sizeof(SimFlash));
+}
+void FlashSave(const char *Path){
+	FILE *f = fopen(Path, "wb");
+	if(!f){
+		perror(Path);
+		return;
+	}else{}
+	fwrite(SimFlash, 1, sizeof(SimFlash), f);
+	fclose(f);
+}
+/******************************************************************************
+ * SimFctl1() - FCTL1 accessor; settles the last operation.
+ *****************************************************************************/
+volatile uint16_t *SimFctl1(void){
+	size_t i;
+	size_t seg;
+	uint64_t bytes = 0;
+
+	if(FCTL1 & ERASE){
+		for(i=0;i<sizeof(SimFlash);i++){
+			if(SimFlash[i] != Shadow[i]){
+				seg = i / FLASH_SEG_LEN;
+				memset(&SimFlash[seg * FLASH_SEG_LEN], 0xFF, FLASH_SEG_LEN);
+				SimRun(FLASH_ERASE_CYC);
+				break;
+			}else{}
+		}
+	}else if(FCTL1 & WRT){
+		for(i=0;i<sizeof(SimFlash);i++){
+			if(SimFlash[i] != Shadow[i]){
+				SimFlash[i] &= Shadow[i];
+				bytes++;
+			}else{}
+		}
+		SimRun(bytes * FLASH_BYTE_CYC);
+	}else{}
+	memcpy(Shadow, SimFlash, sizeof(SimFlash));
+	return &FCTL1;
+}
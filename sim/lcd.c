@@ -0,0 +1,107 @@
+/******************************************************************************
+ * lcd.c - Virtual PCD8544 (Nokia 5110) controller on USCI B0.
+ *
+ * Decodes the command/data byte stream the firmware clocks out, keeps the
+ * 84x48 display RAM and renders it to a PGM image at the end of the run.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "sim.h"
+#include "PCD8544.h"
+
+#define PIXEL_ON  0x28			/*Dark segment*/
+#define PIXEL_OFF 0xC8			/*Background*/
+
+static uint8_t Ram[PCD8544_VBANKS][PCD8544_HPIXELS];
+static int X = 0;
+static int Y = 0;
+static int Extended = 0;		/*H bit of the function set*/
+static int Vertical = 0;		/*V bit of the function set*/
+static int PowerDown = 1;
+static int Display = PCD8544_DISPLAYBLANK;
+static unsigned long DataBytes = 0;
+static unsigned long CommandBytes = 0;
+
+static void Command(uint8_t Byte);
+
+/******************************************************************************
+ * LcdWrite(int, uint8_t) - One byte from the SPI bus; Data is the D/C pin.
+ *****************************************************************************/
+void LcdWrite(int Data, uint8_t Byte){
+	if(!Data){
+		CommandBytes++;
+		Command(Byte);
+		return;
+	}else{}
+	DataBytes++;
+	Ram[Y][X] = Byte;
+	if(Vertical){
+		if(++Y >= PCD8544_VBANKS){
+			Y = 0;
+			X = (X + 1) % PCD8544_HPIXELS;
+		}else{}
+	}else{
+		if(++X >= PCD8544_HPIXELS){
+			X = 0;
+			Y = (Y + 1) % PCD8544_VBANKS;
+		}else{}
+	}
+}
+/******************************************************************************
+ * Command(uint8_t) - Basic and extended instruction sets. The extended set
+ * (contrast, bias, temperature) has no visible effect on the image.
+ *****************************************************************************/
+void Command(uint8_t Byte){
+	if((Byte & 0xF8) == PCD8544_FUNCTIONSET){
+		PowerDown = (Byte & PCD8544_POWERDOWN) != 0;
+		Vertical = (Byte & PCD8544_ENTRYMODE) != 0;
+		Extended = (Byte & PCD8544_EXTENDEDINSTRUCTION) != 0;
+	}else if(Extended){
+	}else if(Byte & PCD8544_SETXADDR){
+		if((Byte & 0x7F) < PCD8544_HPIXELS){
+			X = Byte & 0x7F;
+		}else{}
+	}else if(Byte & PCD8544_SETYADDR){
+		if((Byte & 0x07) < PCD8544_VBANKS){
+			Y = Byte & 0x07;
+		}else{}
+	}else if((Byte & 0xF8) == PCD8544_DISPLAYCONTROL){
+		Display = Byte & PCD8544_DISPLAYINVERTED;
+	}else{}
+}
+/******************************************************************************
+ * LcdReport() - SPI traffic to the display.
+ *****************************************************************************/
+void LcdReport(void){
+	printf("sim: LCD %lu data bytes, %lu commands\n", DataBytes, CommandBytes);
+}
+/******************************************************************************
+ * LcdSavePgm(const char *, int) - Writes the display as a binary PGM image,
+ * each pixel Scale x Scale.
+ *****************************************************************************/
+void LcdSavePgm(const char *Path, int Scale){
+	FILE *f = fopen(Path, "wb");
+	int x;
+	int y;
+	int on;
+
+	if(!f){
+		perror(Path);
+		return;
+	}else{}
+	fprintf(f, "P5\n%d %d\n255\n", PCD8544_HPIXELS * Scale, PCD8544_VBANKS * 8 * Scale);
+	for(y=0;y<PCD8544_VBANKS * 8 * Scale;y++){
+		for(x=0;x<PCD8544_HPIXELS * Scale;x++){
+			on = (Ram[y / Scale / 8][x / Scale] >> ((y / Scale) & 7)) & 1;
+			if(PowerDown || Display == PCD8544_DISPLAYBLANK){
+				on = 0;
+			}else if(Display == PCD8544_DISPLAYALLON){
+				on = 1;
+			}else if(Display == PCD8544_DISPLAYINVERTED){
+				on = !on;
+			}else{}
+			fputc(on ? PIXEL_ON : PIXEL_OFF, f);
+		}
+	}
+	fclose(f);
+}
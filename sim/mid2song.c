@@ -0,0 +1,279 @@
+/******************************************************************************
+ * mid2song.c - Converts a Standard MIDI File to the song format of Song.c.
+ *
+ *   mid2song [-c channel] [-k lowkey] [-n name] file.mid > song.c
+ *
+ * Notes are merged across tracks with the tempo map applied and quantized to
+ * the 10.24 ms slice. Keys below the lowest key the interrupter can play are
+ * raised by octaves, velocity is cut to 4 bits and gaps longer than 31 slices
+ * are split with rests. Output is a C array for Songs.c on stdout.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*Must match Song.h*/
+#define SONG_EVENT(k,v,d) (uint16_t)(((k) << 9) | ((v) << 5) | (d))
+#define SONG_MAX_DELTA    31
+#define SONG_TICK_US      10240.0	/*5 WDT ticks of 2.048 ms*/
+#define LOW_KEY           23		/*Lowest key with a PeriodLookup entry*/
+#define WORDS_PER_LINE    8
+
+typedef struct{
+	uint32_t Tick;
+	uint32_t Order;				/*File order, keeps the sort stable*/
+	uint32_t Tempo;				/*us per quarter note, tempo events only*/
+	uint8_t Status;				/*0 for tempo*/
+	uint8_t Key;
+	uint8_t Velocity;
+}SMF_NOTE;
+
+static SMF_NOTE *Events = NULL;
+static size_t Count = 0;
+static size_t Alloc = 0;
+static uint16_t *Words = NULL;
+static size_t WordCount = 0;
+static size_t WordAlloc = 0;
+
+static int Load(const char *Path, int Channel);
+static SMF_NOTE *Append(uint32_t Tick);
+static void Emit(uint16_t Word);
+static int ReadVlq(const uint8_t **p, const uint8_t *End, uint32_t *Value);
+static int CompareEvents(const void *a, const void *b);
+
+/******************************************************************************
+ * main(int, char **)
+ *****************************************************************************/
+int main(int argc, char **argv){
+	const char *name = "Song0";
+	int channel = -1;
+	int low = LOW_KEY;
+	int opt;
+	int key;
+	int vel;
+	uint32_t lastTick = 0;
+	uint32_t tempo = 500000;
+	uint32_t division;
+	uint32_t slice;
+	uint32_t last = 0;
+	uint32_t delta;
+	double us = 0.0;
+	size_t i;
+
+	while((opt = getopt(argc, argv, "c:k:n:")) != -1){
+		switch(opt){
+		case 'c': channel = atoi(optarg) - 1; break;
+		case 'k': low = atoi(optarg); break;
+		case 'n': name = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-c channel 1-16] [-k lowkey] [-n name] file.mid\n", argv[0]);
+			return 2;
+		}
+	}
+	if(optind != argc - 1 || low < 1 || low > 115){
+		fprintf(stderr, "usage: %s [-c channel 1-16] [-k lowkey] [-n name] file.mid\n", argv[0]);
+		return 2;
+	}else{}
+	division = (uint32_t)Load(argv[optind], channel);
+	if(division == 0){
+		return 1;
+	}else{}
+	qsort(Events, Count, sizeof(SMF_NOTE), CompareEvents);
+
+	for(i=0;i<Count;i++){
+		if(division & 0x8000){				/*SMPTE frames and ticks per frame*/
+			us += (double)(Events[i].Tick - lastTick) * 1e6
+				  / ((double)(256 - (division >> 8)) * (double)(division & 0xFF));
+		}else{
+			us += (double)(Events[i].Tick - lastTick) * (double)tempo / (double)division;
+		}
+		lastTick = Events[i].Tick;
+		if(Events[i].Status == 0){
+			tempo = Events[i].Tempo;
+			continue;
+		}else{}
+		key = Events[i].Key;
+		while(key < low){
+			key += 12;
+		}
+		vel = ((Events[i].Status & 0xF0) == 0x90) ? Events[i].Velocity >> 3 : 0;
+		if(Events[i].Velocity && (Events[i].Status & 0xF0) == 0x90 && vel == 0){
+			vel = 1;						/*Quiet, but still a NOTE_ON*/
+		}else{}
+		slice = (uint32_t)(us / SONG_TICK_US + 0.5);
+		delta = slice - last;
+		last = slice;
+		while(delta > SONG_MAX_DELTA){
+			Emit(SONG_EVENT(0, 0, SONG_MAX_DELTA));
+			delta -= SONG_MAX_DELTA;
+		}
+		Emit(SONG_EVENT(key, vel, delta));
+	}
+
+	printf("/*Generated by sim/mid2song from %s, %lu events*/\n", argv[optind],
+		   (unsigned long)WordCount);
+	printf("const INT16U %s[] = {", name);
+	for(i=0;i<WordCount;i++){
+		printf("%s0x%04X,", (i % WORDS_PER_LINE) ? " " : "\n\t", Words[i]);
+	}
+	printf("%sSONG_END\n};\n", (WordCount % WORDS_PER_LINE) ? " " : "\n\t");
+	return 0;
+}
+/******************************************************************************
+ * Load(const char *, int) - Collects the tempo changes and the NOTE_ON and
+ * NOTE_OFF messages of every track. Returns the division, 0 on error.
+ *****************************************************************************/
+int Load(const char *Path, int Channel){
+	FILE *f = fopen(Path, "rb");
+	uint8_t *buf;
+	const uint8_t *p;
+	const uint8_t *end;
+	const uint8_t *trackEnd;
+	SMF_NOTE *ev;
+	long size;
+	uint32_t tracks;
+	uint32_t division;
+	uint32_t chunk;
+	uint32_t tick;
+	uint32_t delta;
+	uint32_t n;
+	uint8_t status;
+	uint8_t type;
+
+	if(!f){
+		perror(Path);
+		return 0;
+	}else{}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(size > 0 ? (size_t)size : 1);
+	size = (long)fread(buf, 1, (size_t)(size > 0 ? size : 0), f);
+	fclose(f);
+	end = buf + size;
+	if(size < 14 || memcmp(buf, "MThd", 4)){
+		fprintf(stderr, "%s: not a Standard MIDI File\n", Path);
+		free(buf);
+		return 0;
+	}else{}
+	tracks = (buf[10] << 8) | buf[11];
+	division = (buf[12] << 8) | buf[13];
+	p = buf + 8 + ((buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7]);
+
+	while(tracks && p + 8 <= end){
+		chunk = (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+		trackEnd = p + 8 + chunk > end ? end : p + 8 + chunk;
+		if(memcmp(p, "MTrk", 4)){
+			p = trackEnd;					/*Unknown chunk*/
+			continue;
+		}else{}
+		tracks--;
+		p += 8;
+		tick = 0;
+		status = 0;
+		while(p < trackEnd && ReadVlq(&p, trackEnd, &delta) == 0 && p < trackEnd){
+			tick += delta;
+			if(*p == 0xFF){					/*Meta event*/
+				if(p + 2 > trackEnd){
+					break;
+				}else{}
+				type = p[1];
+				p += 2;
+				if(ReadVlq(&p, trackEnd, &n) || p + n > trackEnd){
+					break;
+				}else{}
+				if(type == 0x51 && n == 3){
+					Append(tick)->Tempo = (p[0] << 16) | (p[1] << 8) | p[2];
+				}else{}
+				p += n;
+				if(type == 0x2F){
+					break;
+				}else{}
+			}else if(*p == 0xF0 || *p == 0xF7){	/*SysEx or escape*/
+				p++;
+				if(ReadVlq(&p, trackEnd, &n) || p + n > trackEnd){
+					break;
+				}else{}
+				p += n;
+				status = 0;
+			}else{
+				if(*p & 0x80){
+					status = *p++;
+				}else if(!status){
+					break;						/*Data without status*/
+				}else{}
+				n = ((status & 0xE0) == 0xC0) ? 1 : 2;
+				if(p + n > trackEnd){
+					break;
+				}else{}
+				if(((status & 0xE0) == 0x80) &&
+				   (Channel < 0 || (status & 0x0F) == Channel)){
+					ev = Append(tick);
+					ev->Status = status;
+					ev->Key = p[0];
+					ev->Velocity = p[1];
+				}else{}
+				p += n;
+			}
+		}
+		p = trackEnd;
+	}
+	free(buf);
+	return (int)division;
+}
+/******************************************************************************
+ * Append(uint32_t) - A zeroed event at Tick.
+ *****************************************************************************/
+SMF_NOTE *Append(uint32_t Tick){
+	if(Count == Alloc){
+		Alloc = Alloc ? Alloc * 2 : 1024;
+		Events = realloc(Events, Alloc * sizeof(SMF_NOTE));
+	}else{}
+	memset(&Events[Count], 0, sizeof(SMF_NOTE));
+	Events[Count].Tick = Tick;
+	Events[Count].Order = (uint32_t)Count;
+	return &Events[Count++];
+}
+void Emit(uint16_t Word){
+	if(WordCount == WordAlloc){
+		WordAlloc = WordAlloc ? WordAlloc * 2 : 1024;
+		Words = realloc(Words, WordAlloc * sizeof(uint16_t));
+	}else{}
+	Words[WordCount++] = Word;
+}
+int ReadVlq(const uint8_t **p, const uint8_t *End, uint32_t *Value){
+	uint32_t v = 0;
+	int i;
+	for(i=0;i<4 && *p < End;i++){
+		v = (v << 7) | (**p & 0x7F);
+		if(!(*(*p)++ & 0x80)){
+			*Value = v;
+			return 0;
+		}else{}
+	}
+	return 1;
+}
+/******************************************************************************
+ * CompareEvents(const void *, const void *) - By tick; tempo changes first,
+ * then releases before NOTE_ONs so a repeated key retriggers.
+ *****************************************************************************/
+int CompareEvents(const void *a, const void *b){
+	const SMF_NOTE *x = a;
+	const SMF_NOTE *y = b;
+	int rx;
+	int ry;
+	if(x->Tick != y->Tick){
+		return x->Tick < y->Tick ? -1 : 1;
+	}else{}
+	rx = (x->Status == 0) ? 0 : ((x->Status & 0xF0) == 0x90 && x->Velocity) ? 2 : 1;
+	ry = (y->Status == 0) ? 0 : ((y->Status & 0xF0) == 0x90 && y->Velocity) ? 2 : 1;
+	if(rx != ry){
+		return rx < ry ? -1 : 1;
+	}else{
+		return x->Order < y->Order ? -1 : (x->Order > y->Order);
+	}
+}
@@ -0,0 +1,641 @@
+/******************************************************************************
+ * midibench.c - Throughput benchmark and golden trace check of the MIDI
+ * engine on the host.
+ *
+ *   midibench [-s messages] [-n passes] [-w trace.txt | -g golden.txt]
+ *             [file ...]
+ *
+ * The firmware sources are linked unmodified, without the simulator: each
+ * byte of the input goes through MIDI_RX() and HandleMidiFrameTask() as the
+ * receive interrupt and the kernel would run them, with the registers as
+ * plain variables and the TX interrupt run whenever interrupts are enabled.
+ * No timer or WDT interrupt runs, so the duty limiter and the poly pulse
+ * scheduler stay out of the measurement; TA1R advances one byte time (320 us)
+ * per byte so time stamps and tempo tracking see a real byte rate.
+ *
+ * The input is the given files (Standard MIDI Files, with every track merged
+ * in time order, or raw MIDI bytes) followed by -s synthetic messages: notes,
+ * bends, pressure and controllers on three channels, with running status,
+ * from a fixed seed. The stream is played -n times. The first pass is timed
+ * message by message for the distribution and records TA0CCR0, TA0CCR1 and
+ * TA0CCTL1 after every message that changes them; -w saves that trace and -g
+ * compares it with a saved one and fails at the first difference. The other
+ * passes run untimed for the throughput.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+#define SIM_DEFINE_REGISTERS
+#define SIM_INTERNAL
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "msp430g2553.h"
+
+#define MIDI_MODE        0			/*Must match includes.h*/
+#define BYTE_TICKS       5120		/*10 bits at 31250 baud in TA1 ticks*/
+#define FLASH_BYTES      1024		/*Two store segments, erased*/
+#define SEED             0x2013u
+#define SYNTH_CHANNELS   3			/*Channels 1 - 3*/
+#define CALIBRATE_RUNS   10000
+#define TRACE_LINE       26
+
+typedef struct{
+	uint32_t Tick;
+	uint32_t Order;					/*File order, keeps the sort stable*/
+	uint32_t Offset;				/*Message bytes in Pool*/
+	uint32_t Length;
+}SMF_EVENT;
+
+/*Firmware*/
+extern uint8_t Mode;
+void MIDI_RX(void);
+void MIDI_TX(void);
+void TimeRollover(void);
+void HandleMidiFrameTask(void);
+void SynthInit(void);
+void StoreInit(void);
+
+/*Shim state*/
+uint8_t SimFlash[FLASH_BYTES];
+const uint8_t CALBC1_16MHZ = 0x8F;
+const uint8_t CALDCO_16MHZ = 0x95;
+static volatile uint8_t RxByte;
+static volatile uint8_t TxByte;
+static volatile uint8_t SpiByte;
+static volatile uint16_t Fctl1;
+static int Gie = 0;
+static int InTx = 0;
+
+/*Input*/
+static uint8_t *Stream = NULL;
+static size_t StreamLen = 0;
+static size_t StreamAlloc = 0;
+static uint32_t *Starts = NULL;		/*Offset of each message*/
+static size_t Messages = 0;
+
+/*First pass results*/
+static char *Trace = NULL;
+static size_t TraceLen = 0;
+static size_t TraceAlloc = 0;
+static uint32_t *Times = NULL;		/*ns per message*/
+
+static void Append(const uint8_t *Bytes, size_t Len);
+static int LoadFile(const char *Path);
+static int LoadSmf(const uint8_t *Buf, size_t Size, const char *Path);
+static int ReadVlq(const uint8_t **p, const uint8_t *End, uint32_t *Value);
+static int CompareEvents(const void *a, const void *b);
+static void Synthesize(size_t Count);
+static uint32_t Random(void);
+static void Split(void);
+static size_t MessageLength(uint8_t Status);
+static void Play(size_t Message);
+static void Record(size_t Message);
+static uint64_t Now(void);
+static int CompareTimes(const void *a, const void *b);
+static int Check(const char *Path);
+
+/******************************************************************************
+ * main(int, char **)
+ *****************************************************************************/
+int main(int argc, char **argv){
+	const char *writePath = NULL;
+	const char *goldenPath = NULL;
+	long synthetic = 0;
+	long passes = 1;
+	uint64_t t0;
+	uint64_t t1;
+	uint64_t overhead = UINT64_MAX;
+	double seconds;
+	size_t m;
+	long p;
+	int opt;
+	int i;
+	FILE *f;
+
+	while((opt = getopt(argc, argv, "s:n:w:g:")) != -1){
+		switch(opt){
+		case 's': synthetic = atol(optarg); break;
+		case 'n': passes = atol(optarg); break;
+		case 'w': writePath = optarg; break;
+		case 'g': goldenPath = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-s messages] [-n passes] [-w trace.txt | -g golden.txt] [file ...]\n", argv[0]);
+			return 2;
+		}
+	}
+	if(synthetic < 0 || passes < 1 || (writePath && goldenPath)){
+		fprintf(stderr, "%s: bad options\n", argv[0]);
+		return 2;
+	}else{}
+	for(i=optind;i<argc;i++){
+		if(LoadFile(argv[i])){
+			return 1;
+		}else{}
+	}
+	Synthesize((size_t)synthetic);
+	Split();
+	if(Messages == 0){
+		fprintf(stderr, "%s: no input; give files or -s\n", argv[0]);
+		return 2;
+	}else{}
+	Times = malloc(Messages * sizeof(uint32_t));
+
+	memset(SimFlash, 0xFF, sizeof(SimFlash));	/*Boot as SystemInit() leaves MIDI*/
+	IFG2 = UCA0TXIFG | UCB0TXIFG;
+	TA1CCR0 = 65535;
+	SynthInit();
+	StoreInit();
+	Mode = MIDI_MODE;
+	Gie = 1;
+
+	for(i=0;i<CALIBRATE_RUNS;i++){					/*Cost of the clock itself*/
+		t0 = Now();
+		t1 = Now();
+		if(t1 - t0 < overhead){
+			overhead = t1 - t0;
+		}else{}
+	}
+	for(m=0;m<Messages;m++){
+		t0 = Now();
+		Play(m);
+		t1 = Now();
+		Times[m] = (uint32_t)((t1 - t0 > overhead) ? t1 - t0 - overhead : 0);
+		Record(m);
+	}
+	t0 = Now();
+	for(p=1;p<passes;p++){
+		for(m=0;m<Messages;m++){
+			Play(m);
+		}
+	}
+	t1 = Now();
+
+	printf("midibench: %lu messages, %lu bytes, %lu passes\n", (unsigned long)Messages,
+		   (unsigned long)StreamLen, passes);
+	if(passes > 1){
+		seconds = (double)(t1 - t0) / 1e9;
+		printf("midibench: %.0f messages/s, %.1f ns/message\n",
+			   (double)Messages * (double)(passes - 1) / seconds,
+			   (double)(t1 - t0) / ((double)Messages * (double)(passes - 1)));
+	}else{}
+	qsort(Times, Messages, sizeof(uint32_t), CompareTimes);
+	printf("midibench: ns/message min %u p50 %u p90 %u p99 %u max %u (clock %lu ns)\n",
+		   Times[0], Times[Messages / 2], Times[Messages * 9 / 10], Times[Messages * 99 / 100],
+		   Times[Messages - 1], (unsigned long)overhead);
+	printf("midibench: %lu output changes\n", (unsigned long)(TraceLen / TRACE_LINE));
+
+	if(writePath){
+		f = fopen(writePath, "w");
+		if(!f){
+			perror(writePath);
+			return 1;
+		}else{}
+		fwrite(Trace, 1, TraceLen, f);
+		fclose(f);
+	}else{}
+	if(goldenPath){
+		return Check(goldenPath);
+	}else{}
+	return 0;
+}
+/******************************************************************************
+ * Play(size_t) - Receives one message a byte at a time; the kernel drains
+ * the FIFO after every byte as it would with bytes 320 us apart.
+ *****************************************************************************/
+void Play(size_t Message){
+	uint32_t i;
+	for(i=Starts[Message];i<Starts[Message + 1];i++){
+		TA1R = (uint16_t)(TA1R + BYTE_TICKS);
+		if(TA1R < BYTE_TICKS){
+			TimeRollover();
+		}else{}
+		RxByte = Stream[i];
+		Gie = 0;
+		MIDI_RX();
+		__set_interrupt_state(GIE);
+		HandleMidiFrameTask();
+	}
+}
+/******************************************************************************
+ * Record(size_t) - Adds a trace line if the message changed the output.
+ * Lines are fixed length so the count falls out of the size.
+ *****************************************************************************/
+void Record(size_t Message){
+	static uint16_t ccr0 = 0;
+	static uint16_t ccr1 = 0;
+	static uint16_t cctl1 = 0;
+	static int first = 1;
+	if(!first && TA0CCR0 == ccr0 && TA0CCR1 == ccr1 && TA0CCTL1 == cctl1){
+		return;
+	}else{}
+	first = 0;
+	ccr0 = TA0CCR0;
+	ccr1 = TA0CCR1;
+	cctl1 = TA0CCTL1;
+	if(TraceLen + TRACE_LINE + 1 > TraceAlloc){
+		TraceAlloc = TraceAlloc ? TraceAlloc * 2 : 65536;
+		Trace = realloc(Trace, TraceAlloc);
+	}else{}
+	TraceLen += (size_t)snprintf(&Trace[TraceLen], TRACE_LINE + 1, "%10lu %04X %04X %04X\n",
+								 (unsigned long)Message, ccr0, ccr1, cctl1);
+}
+/******************************************************************************
+ * Check(const char *) - Compares the trace with a golden one line by line.
+ *****************************************************************************/
+int Check(const char *Path){
+	FILE *f = fopen(Path, "r");
+	char line[TRACE_LINE + 2];
+	size_t at = 0;
+	size_t n = 0;
+
+	if(!f){
+		perror(Path);
+		return 1;
+	}else{}
+	while(fgets(line, sizeof(line), f)){
+		n++;
+		if(at >= TraceLen || strncmp(line, &Trace[at], TRACE_LINE)){
+			printf("midibench: differs from %s at line %lu\n  golden: %s  now:    %.*s",
+				   Path, (unsigned long)n, line, at < TraceLen ? TRACE_LINE : 1,
+				   at < TraceLen ? &Trace[at] : "\n");
+			fclose(f);
+			return 1;
+		}else{}
+		at += TRACE_LINE;
+	}
+	fclose(f);
+	if(at != TraceLen){
+		printf("midibench: %lu more output changes than %s\n",
+			   (unsigned long)((TraceLen - at) / TRACE_LINE), Path);
+		return 1;
+	}else{}
+	printf("midibench: output matches %s\n", Path);
+	return 0;
+}
+/******************************************************************************
+ * Split() - Finds the start of every message in the stream: a status byte
+ * and its data bytes, data bytes under running status, or a whole SysEx.
+ * Stray data bytes go with the message before them.
+ *****************************************************************************/
+void Split(void){
+	size_t alloc = 1024;
+	size_t i = 0;
+	size_t len;
+	uint8_t running = 0;
+
+	Starts = malloc(alloc * sizeof(uint32_t));
+	while(i < StreamLen){
+		if(Messages + 2 > alloc){
+			alloc *= 2;
+			Starts = realloc(Starts, alloc * sizeof(uint32_t));
+		}else{}
+		Starts[Messages++] = (uint32_t)i;
+		if(Stream[i] == 0xF0){
+			while(i < StreamLen && Stream[i] != 0xF7){
+				i++;
+			}
+			i++;
+			running = 0;
+			continue;
+		}else if(Stream[i] >= 0xF8){
+			i++;
+			continue;
+		}else if(Stream[i] & 0x80){
+			running = (Stream[i] < 0xF0) ? Stream[i] : 0;
+			len = 1 + MessageLength(Stream[i]);
+		}else{
+			len = running ? MessageLength(running) : 1;
+		}
+		i += len;
+		while(i < StreamLen && !(Stream[i] & 0x80) && !running){
+			i++;									/*Stray data*/
+		}
+	}
+	if(i > StreamLen){
+		i = StreamLen;
+	}else{}
+	Starts[Messages] = (uint32_t)i;
+}
+size_t MessageLength(uint8_t Status){
+	static const uint8_t system[8] = {0, 1, 2, 1, 0, 1, 0, 0};
+	if(Status >= 0xF0){
+		return system[Status & 0x07];
+	}else{
+		return ((Status & 0xE0) == 0xC0) ? 1 : 2;
+	}
+}
+/******************************************************************************
+ * Synthesize(size_t) - Appends Count messages of a busy performance: notes
+ * on and off, bends, pressure and controllers, mostly under running status.
+ * Each channel keeps a few keys held so NOTE_OFFs hit held notes.
+ *****************************************************************************/
+void Synthesize(size_t Count){
+	static const uint8_t controllers[5] = {1, 7, 10, 64, 80};
+	uint8_t held[SYNTH_CHANNELS][8];
+	uint8_t heldCount[SYNTH_CHANNELS] = {0};
+	uint8_t msg[3];
+	uint8_t status = 0;
+	uint8_t ch;
+	uint32_t r;
+	size_t n;
+	size_t len;
+
+	for(n=0;n<Count;n++){
+		r = Random();
+		ch = (uint8_t)(r % SYNTH_CHANNELS);
+		r /= SYNTH_CHANNELS;
+		switch(r % 20){
+		case 0: case 1: case 2: case 3: case 4: case 5: case 6:
+			if(heldCount[ch] < 8){
+				msg[0] = 0x90 | ch;
+				msg[1] = (uint8_t)(30 + Random() % 70);
+				msg[2] = (uint8_t)(1 + Random() % 127);
+				held[ch][heldCount[ch]++] = msg[1];
+				break;
+			}else{}
+			/*Fall through to release one*/
+		case 7: case 8: case 9: case 10: case 11: case 12:
+			if(heldCount[ch] == 0){
+				msg[0] = 0x90 | ch;					/*Velocity 0 release of nothing*/
+				msg[1] = 60;
+				msg[2] = 0;
+			}else{
+				r = Random() % heldCount[ch];
+				msg[0] = (Random() & 1) ? (0x80 | ch) : (0x90 | ch);
+				msg[1] = held[ch][r];
+				msg[2] = 0;
+				held[ch][r] = held[ch][--heldCount[ch]];
+			}
+			break;
+		case 13: case 14: case 15:
+			msg[0] = 0xE0 | ch;
+			msg[1] = (uint8_t)(Random() & 0x7F);
+			msg[2] = (uint8_t)(Random() & 0x7F);
+			break;
+		case 16:
+			msg[0] = 0xD0 | ch;
+			msg[1] = (uint8_t)(Random() & 0x7F);
+			break;
+		case 17:
+			msg[0] = 0xA0 | ch;
+			msg[1] = heldCount[ch] ? held[ch][0] : 60;
+			msg[2] = (uint8_t)(Random() & 0x7F);
+			break;
+		default:
+			msg[0] = 0xB0 | ch;
+			msg[1] = controllers[Random() % 5];
+			msg[2] = (uint8_t)(Random() & 0x7F);
+			break;
+		}
+		len = 1 + MessageLength(msg[0]);
+		if(msg[0] == status && (Random() & 3)){
+			Append(&msg[1], len - 1);				/*Running status*/
+		}else{
+			Append(msg, len);
+		}
+		status = msg[0];
+	}
+}
+uint32_t Random(void){
+	static uint32_t state = SEED;
+	state = state * 1103515245u + 12345u;
+	return state >> 8;
+}
+/******************************************************************************
+ * LoadFile(const char *) - A Standard MIDI File, or raw MIDI bytes.
+ *****************************************************************************/
+int LoadFile(const char *Path){
+	FILE *f = fopen(Path, "rb");
+	uint8_t *buf;
+	long size;
+	int result = 0;
+
+	if(!f){
+		perror(Path);
+		return 1;
+	}else{}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(size > 0 ? (size_t)size : 1);
+	size = (long)fread(buf, 1, (size_t)(size > 0 ? size : 0), f);
+	fclose(f);
+	if(size >= 14 && !memcmp(buf, "MThd", 4)){
+		result = LoadSmf(buf, (size_t)size, Path);
+	}else{
+		Append(buf, (size_t)size);
+	}
+	free(buf);
+	return result;
+}
+/******************************************************************************
+ * LoadSmf(const uint8_t *, size_t, const char *) - Merges the channel and
+ * SysEx messages of every track by tick. Each message is sent with its
+ * status byte.
+ *****************************************************************************/
+int LoadSmf(const uint8_t *Buf, size_t Size, const char *Path){
+	const uint8_t *end = Buf + Size;
+	const uint8_t *p;
+	const uint8_t *trackEnd;
+	SMF_EVENT *events = NULL;
+	uint8_t *pool = NULL;
+	size_t count = 0;
+	size_t alloc = 0;
+	size_t poolLen = 0;
+	size_t i;
+	uint32_t tracks = (uint32_t)((Buf[10] << 8) | Buf[11]);
+	uint32_t chunk;
+	uint32_t tick;
+	uint32_t delta;
+	uint32_t n;
+	uint8_t status;
+
+	pool = malloc(Size + Size / 2 + 16);			/*Never more than the file plus statuses*/
+	p = Buf + 8 + ((Buf[4] << 24) | (Buf[5] << 16) | (Buf[6] << 8) | Buf[7]);
+	while(tracks && p + 8 <= end){
+		chunk = (uint32_t)((p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7]);
+		trackEnd = (chunk > (size_t)(end - p) - 8) ? end : p + 8 + chunk;
+		if(memcmp(p, "MTrk", 4)){
+			p = trackEnd;
+			continue;
+		}else{}
+		tracks--;
+		p += 8;
+		tick = 0;
+		status = 0;
+		while(p < trackEnd && ReadVlq(&p, trackEnd, &delta) == 0 && p < trackEnd){
+			tick += delta;
+			if(count == alloc){
+				alloc = alloc ? alloc * 2 : 1024;
+				events = realloc(events, alloc * sizeof(SMF_EVENT));
+			}else{}
+			events[count].Tick = tick;
+			events[count].Order = (uint32_t)count;
+			events[count].Offset = (uint32_t)poolLen;
+			if(*p == 0xFF){								/*Meta event*/
+				if(p + 2 > trackEnd || p[1] == 0x2F){
+					break;
+				}else{}
+				p += 2;
+				if(ReadVlq(&p, trackEnd, &n) || n > (size_t)(trackEnd - p)){
+					break;
+				}else{}
+				p += n;
+				continue;
+			}else if(*p == 0xF0){
+				p++;
+				if(ReadVlq(&p, trackEnd, &n) || n > (size_t)(trackEnd - p)){
+					break;
+				}else{}
+				pool[poolLen++] = 0xF0;
+				memcpy(&pool[poolLen], p, n);
+				poolLen += n;
+				p += n;
+				status = 0;
+			}else if(*p == 0xF7){						/*Escape, not a message*/
+				p++;
+				if(ReadVlq(&p, trackEnd, &n) || n > (size_t)(trackEnd - p)){
+					break;
+				}else{}
+				p += n;
+				continue;
+			}else{
+				if(*p & 0x80){
+					status = *p++;
+				}else if(!status){
+					break;
+				}else{}
+				n = (uint32_t)MessageLength(status);
+				if(n > (size_t)(trackEnd - p)){
+					break;
+				}else{}
+				pool[poolLen++] = status;
+				memcpy(&pool[poolLen], p, n);
+				poolLen += n;
+				p += n;
+			}
+			events[count].Length = (uint32_t)poolLen - events[count].Offset;
+			count++;
+		}
+		p = trackEnd;
+	}
+	if(count == 0){
+		fprintf(stderr, "%s: no MIDI messages\n", Path);
+		free(events);
+		free(pool);
+		return 1;
+	}else{}
+	qsort(events, count, sizeof(SMF_EVENT), CompareEvents);
+	for(i=0;i<count;i++){
+		Append(&pool[events[i].Offset], events[i].Length);
+	}
+	free(events);
+	free(pool);
+	return 0;
+}
+int ReadVlq(const uint8_t **p, const uint8_t *End, uint32_t *Value){
+	uint32_t v = 0;
+	int i;
+	for(i=0;i<4 && *p < End;i++){
+		v = (v << 7) | (**p & 0x7F);
+		if(!(*(*p)++ & 0x80)){
+			*Value = v;
+			return 0;
+		}else{}
+	}
+	return 1;
+}
+int CompareEvents(const void *a, const void *b){
+	const SMF_EVENT *x = a;
+	const SMF_EVENT *y = b;
+	if(x->Tick != y->Tick){
+		return x->Tick < y->Tick ? -1 : 1;
+	}else{
+		return x->Order < y->Order ? -1 : (x->Order > y->Order);
+	}
+}
+void Append(const uint8_t *Bytes, size_t Len){
+	if(StreamLen + Len > StreamAlloc){
+		StreamAlloc = (StreamLen + Len) * 2;
+		Stream = realloc(Stream, StreamAlloc);
+	}else{}
+	memcpy(&Stream[StreamLen], Bytes, Len);
+	StreamLen += Len;
+}
+uint64_t Now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+int CompareTimes(const void *a, const void *b){
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/******************************************************************************
+ * Register shim: plain registers, no time. Interrupts are a flag; a pending
+ * TX interrupt runs when they are enabled.
+ *****************************************************************************/
+volatile uint8_t *SimIfg2(void){
+	return &IFG2;
+}
+volatile uint8_t *SimUartRxBuf(void){
+	return &RxByte;
+}
+volatile uint8_t *SimUartTxBuf(void){
+	return &TxByte;
+}
+volatile uint8_t *SimSpiTxBuf(void){
+	return &SpiByte;
+}
+volatile uint16_t *SimFctl1(void){
+	return &Fctl1;
+}
+void __bis_SR_register(unsigned short Bits){
+	if(Bits & GIE){
+		__enable_interrupt();
+	}else{}
+}
+void __bic_SR_register(unsigned short Bits){
+	if(Bits & GIE){
+		Gie = 0;
+	}else{}
+}
+void __bis_SR_register_on_exit(unsigned short Bits){
+	(void)Bits;
+}
+void __bic_SR_register_on_exit(unsigned short Bits){
+	(void)Bits;
+}
+void __delay_cycles(unsigned long Cycles){
+	(void)Cycles;
+}
+void __disable_interrupt(void){
+	Gie = 0;
+}
+void __enable_interrupt(void){
+	Gie = 1;
+	if(InTx){
+		return;
+	}else{}
+	InTx = 1;
+	while(IE2 & UCA0TXIE){
+		MIDI_TX();
+	}
+	InTx = 0;
+}
+unsigned short __get_interrupt_state(void){
+	return Gie ? GIE : 0;
+}
+void __set_interrupt_state(unsigned short State){
+	if(State & GIE){
+		__enable_interrupt();
+	}else{
+		Gie = 0;
+	}
+}
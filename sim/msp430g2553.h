@@ -0,0 +1,254 @@
+/******************************************************************************
+ * msp430g2553.h - Register shim for the host simulation build.
+ *
+ * Registers are plain variables owned by the simulator (sim.c). The few
+ * registers with access side effects go through accessors so the attached
+ * peripheral models see every access: writes to UCA0TXBUF/UCB0TXBUF reach the
+ * UART and LCD models, reading UCA0RXBUF clears UCA0RXIFG, every IFG2 poll
+ * costs SIM_POLL_CYCLES of virtual time so busy-waits terminate, and FCTL1
+ * writes drive the flash model.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#ifndef SIM_MSP430G2553_H
+#define SIM_MSP430G2553_H
+#include <stdint.h>
+
+#ifdef SIM_DEFINE_REGISTERS
+#define SFR8(n)  volatile uint8_t n
+#define SFR16(n) volatile uint16_t n
+#else
+#define SFR8(n)  extern volatile uint8_t n
+#define SFR16(n) extern volatile uint16_t n
+#endif
+
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+/*Status Register*/
+#define GIE       0x0008
+#define CPUOFF    0x0010
+#define OSCOFF    0x0020
+#define SCG0      0x0040
+#define SCG1      0x0080
+#define LPM0_bits (CPUOFF)
+#define LPM1_bits (SCG0 | CPUOFF)
+#define LPM3_bits (SCG1 | SCG0 | CPUOFF)
+
+/*Special Function*/
+SFR8(IE1); SFR8(IFG1); SFR8(IE2); SFR8(IFG2);
+#define WDTIE     0x01
+#define WDTIFG    0x01
+#define UCA0RXIE  0x01
+#define UCA0TXIE  0x02
+#define UCB0RXIE  0x04
+#define UCB0TXIE  0x08
+#define UCA0RXIFG 0x01
+#define UCA0TXIFG 0x02
+#define UCB0RXIFG 0x04
+#define UCB0TXIFG 0x08
+
+/*Watchdog Timer*/
+SFR16(WDTCTL);
+#define WDTIS0   0x0001
+#define WDTIS1   0x0002
+#define WDTSSEL  0x0004
+#define WDTCNTCL 0x0008
+#define WDTTMSEL 0x0010
+#define WDTNMI   0x0020
+#define WDTHOLD  0x0080
+#define WDTPW    0x5A00
+#define WDT_MDLY_32  (WDTPW | WDTTMSEL | WDTCNTCL)
+#define WDT_MDLY_8   (WDTPW | WDTTMSEL | WDTCNTCL | WDTIS0)
+#define WDT_MDLY_0_5 (WDTPW | WDTTMSEL | WDTCNTCL | WDTIS1)
+
+/*Basic Clock*/
+SFR8(BCSCTL1); SFR8(BCSCTL2); SFR8(BCSCTL3); SFR8(DCOCTL);
+extern const uint8_t CALBC1_16MHZ, CALDCO_16MHZ;
+
+/*Ports*/
+SFR8(P1IN); SFR8(P1OUT); SFR8(P1DIR); SFR8(P1SEL); SFR8(P1SEL2); SFR8(P1REN);
+SFR8(P1IE); SFR8(P1IES); SFR8(P1IFG);
+SFR8(P2IN); SFR8(P2OUT); SFR8(P2DIR); SFR8(P2SEL); SFR8(P2SEL2); SFR8(P2REN);
+SFR8(P2IE); SFR8(P2IES); SFR8(P2IFG);
+
+/*Timer_A*/
+SFR16(TA0CTL); SFR16(TA0R); SFR16(TA0IV);
+SFR16(TA0CCTL0); SFR16(TA0CCTL1); SFR16(TA0CCTL2);
+SFR16(TA0CCR0);  SFR16(TA0CCR1);  SFR16(TA0CCR2);
+SFR16(TA1CTL); SFR16(TA1R); SFR16(TA1IV);
+SFR16(TA1CCTL0); SFR16(TA1CCTL1); SFR16(TA1CCTL2);
+SFR16(TA1CCR0);  SFR16(TA1CCR1);  SFR16(TA1CCR2);
+#define TASSEL_0 0x0000
+#define TASSEL_1 0x0100
+#define TASSEL_2 0x0200
+#define ID_0     0x0000
+#define ID_1     0x0040
+#define ID_2     0x0080
+#define ID_3     0x00C0
+#define MC_0     0x0000
+#define MC_1     0x0010
+#define MC_2     0x0020
+#define MC_3     0x0030
+#define TACLR    0x0004
+#define TAIE     0x0002
+#define TAIFG    0x0001
+#define CM_0     0x0000
+#define CM_1     0x4000
+#define CM_2     0x8000
+#define CM_3     0xC000
+#define CCIS_0   0x0000
+#define CCIS_1   0x1000
+#define CCIS_2   0x2000
+#define CCIS_3   0x3000
+#define SCS      0x0800
+#define SCCI     0x0400
+#define CAP      0x0100
+#define OUTMOD_0 0x0000
+#define OUTMOD_1 0x0020
+#define OUTMOD_2 0x0040
+#define OUTMOD_3 0x0060
+#define OUTMOD_4 0x0080
+#define OUTMOD_5 0x00A0
+#define OUTMOD_6 0x00C0
+#define OUTMOD_7 0x00E0
+#define CCIE     0x0010
+#define CCI      0x0008
+#define OUT      0x0004
+#define COV      0x0002
+#define CCIFG    0x0001
+#define TA0IV_NONE   0x0000
+#define TA0IV_TACCR1 0x0002
+#define TA0IV_TACCR2 0x0004
+#define TA0IV_TAIFG  0x000A
+#define TA1IV_NONE   0x0000
+#define TA1IV_TACCR1 0x0002
+#define TA1IV_TACCR2 0x0004
+#define TA1IV_TAIFG  0x000A
+
+/*USCI*/
+SFR8(UCA0CTL0); SFR8(UCA0CTL1); SFR8(UCA0BR0); SFR8(UCA0BR1); SFR8(UCA0MCTL);
+SFR8(UCA0STAT); SFR8(UCA0RXBUF); SFR8(UCA0TXBUF);
+SFR8(UCB0CTL0); SFR8(UCB0CTL1); SFR8(UCB0BR0); SFR8(UCB0BR1);
+SFR8(UCB0STAT); SFR8(UCB0RXBUF); SFR8(UCB0TXBUF);
+#define UCCKPH   0x80
+#define UCCKPL   0x40
+#define UCMSB    0x20
+#define UC7BIT   0x10
+#define UCMST    0x08
+#define UCSYNC   0x01
+#define UCSSEL_1 0x40
+#define UCSSEL_2 0x80
+#define UCSWRST  0x01
+#define UCOE     0x20
+#define UCBUSY   0x01
+
+/*ADC10*/
+SFR16(ADC10CTL0); SFR16(ADC10CTL1); SFR16(ADC10MEM); SFR16(ADC10SA);
+SFR8(ADC10AE0); SFR8(ADC10DTC0); SFR8(ADC10DTC1);
+#define ADC10SC     0x0001
+#define ENC         0x0002
+#define ADC10IFG    0x0004
+#define ADC10IE     0x0008
+#define ADC10ON     0x0010
+#define REFON       0x0020
+#define MSC         0x0080
+#define ADC10SR     0x0400
+#define ADC10SHT_0  0x0000
+#define ADC10SHT_1  0x0800
+#define ADC10SHT_2  0x1000
+#define ADC10SHT_3  0x1800
+#define BUSY        0x0001
+#define CONSEQ_0    0x0000
+#define CONSEQ_1    0x0002
+#define CONSEQ_2    0x0004
+#define CONSEQ_3    0x0006
+#define ADC10SSEL_0 0x0000
+#define ADC10SSEL_3 0x0018
+#define ADC10DIV_0  0x0000
+#define ADC10DIV_7  0x00E0
+#define INCH_0      0x0000
+#define INCH_1      0x1000
+#define INCH_2      0x2000
+#define INCH_3      0x3000
+#define INCH_4      0x4000
+#define INCH_5      0x5000
+#define INCH_6      0x6000
+#define INCH_7      0x7000
+#define ADC10FETCH  0x01
+#define ADC10B1     0x02
+#define ADC10CT     0x04
+#define ADC10TB     0x08
+
+/*Flash*/
+SFR16(FCTL1); SFR16(FCTL2); SFR16(FCTL3);
+#define FWKEY  0xA500
+#define FRKEY  0x9600
+#define ERASE  0x0002
+#define MERAS  0x0004
+#define WRT    0x0040
+#define BLKWRT 0x0080
+#define FSSEL_1 0x0040
+#define FSSEL_2 0x0080
+#define FN0    0x0001
+#define FN1    0x0002
+#define FN2    0x0004
+#define FN3    0x0008
+#define FN4    0x0010
+#define FN5    0x0020
+#define BUSY_F 0x0001
+#define LOCK   0x0010
+#define WAIT   0x0008
+extern uint8_t SimFlash[];		/*Store segments, see flash.c*/
+#define FLASH_SEGMENT(n) (SimFlash + ((n) << 9))
+
+/*Interrupt Vectors; the number is also the priority*/
+#define PORT1_VECTOR      2
+#define PORT2_VECTOR      3
+#define ADC10_VECTOR      5
+#define USCIAB0TX_VECTOR  6
+#define USCIAB0RX_VECTOR  7
+#define TIMER0_A1_VECTOR  8
+#define TIMER0_A0_VECTOR  9
+#define WDT_VECTOR        10
+#define COMPARATORA_VECTOR 11
+#define TIMER1_A1_VECTOR  12
+#define TIMER1_A0_VECTOR  13
+#define NMI_VECTOR        14
+
+/*Compiler Intrinsics*/
+#define __interrupt
+#define __no_init
+#define __root
+void __bis_SR_register(unsigned short Bits);
+void __bic_SR_register(unsigned short Bits);
+void __bis_SR_register_on_exit(unsigned short Bits);
+void __bic_SR_register_on_exit(unsigned short Bits);
+void __delay_cycles(unsigned long Cycles);
+void __disable_interrupt(void);
+void __enable_interrupt(void);
+unsigned short __get_interrupt_state(void);
+void __set_interrupt_state(unsigned short State);
+#define __no_operation() ((void)0)
+
+/*Registers with access side effects (see sim.c)*/
+volatile uint8_t *SimIfg2(void);
+volatile uint8_t *SimUartRxBuf(void);
+volatile uint8_t *SimUartTxBuf(void);
+volatile uint8_t *SimSpiTxBuf(void);
+volatile uint16_t *SimFctl1(void);
+#ifndef SIM_INTERNAL
+#define FCTL1     (*SimFctl1())
+#define IFG2      (*SimIfg2())
+#define UCA0RXBUF (*SimUartRxBuf())
+#define UCA0TXBUF (*SimUartTxBuf())
+#define UCB0TXBUF (*SimSpiTxBuf())
+#endif
+
+#endif
@@ -0,0 +1,172 @@
+#!/usr/bin/awk -f
+#******************************************************************************
+# ramsize.awk - Static RAM of the firmware on the MSP430, from host objects.
+#
+# Reads, for each object, a line "@OBJ name", a line "@RAM symbol" for every
+# .data/.bss symbol nm lists, then the object's readelf --debug-dump=info.
+# Each RAM variable is sized from its DWARF type with the MSP430's rules:
+# pointers, int and enums are 2 bytes, long is 4, and nothing is aligned to
+# more than 2 bytes; structs are laid out again under those rules. Prints
+# the bytes of each module and the total, and fails when the total is over
+# limit. -v list=1 also prints every variable.
+#
+# WWU EET Senior Project - AMDRSSTC Interrupter
+#******************************************************************************
+function reset(){
+	split("", Tag); split("", Name); split("", Type); split("", Size)
+	split("", Count); split("", Kids); split("", Kid); split("", Ram)
+	split("", Var); split("", Depth)
+	Vars = 0
+}
+function follow(o){
+	while(Tag[o] == "typedef" || Tag[o] == "const_type" || Tag[o] == "volatile_type"){
+		o = Type[o]
+	}
+	return o
+}
+function tsize(o,    n, i, k, off, al, a, s){
+	o = follow(o)
+	if(Tag[o] == "base_type"){
+		return (Name[o] == "int" || Name[o] == "unsigned int") ? 2 : Size[o]
+	}else if(Tag[o] == "pointer_type" || Tag[o] == "enumeration_type"){
+		return 2
+	}else if(Tag[o] == "array_type"){
+		n = 1
+		for(i=1;i<=Kids[o];i++){
+			n *= Count[Kid[o, i]]
+		}
+		return n * tsize(Type[o])
+	}else if(Tag[o] == "structure_type" || Tag[o] == "union_type"){
+		off = 0
+		al = 1
+		for(i=1;i<=Kids[o];i++){
+			k = Kid[o, i]
+			a = talign(Type[k])
+			s = tsize(Type[k])
+			if(a > al){
+				al = a
+			}
+			if(Tag[o] == "union_type"){
+				if(s > off){
+					off = s
+				}
+			}else{
+				off = int((off + a - 1) / a) * a + s
+			}
+		}
+		return int((off + al - 1) / al) * al
+	}
+	print "ramsize: no size for DWARF " Tag[o] " <" o ">" > "/dev/stderr"
+	Failed = 1
+	return 0
+}
+function talign(o,    i, a, al){
+	o = follow(o)
+	if(Tag[o] == "array_type"){
+		return talign(Type[o])
+	}else if(Tag[o] == "structure_type" || Tag[o] == "union_type"){
+		al = 1
+		for(i=1;i<=Kids[o];i++){
+			a = talign(Type[Kid[o, i]])
+			if(a > al){
+				al = a
+			}
+		}
+		return al
+	}
+	return (tsize(o) > 1) ? 2 : 1
+}
+function finish(    i, o, s, total){
+	if(Module == ""){
+		return
+	}
+	total = 0
+	for(i=1;i<=Vars;i++){
+		o = Var[i]
+		if(Ram[Name[o]] > 0){
+			s = tsize(Type[o])
+			total += s
+			if(list){
+				printf "  %-22s %4d\n", Name[o], s
+			}
+			Ram[Name[o]]--
+		}
+	}
+	for(s in Ram){
+		if(Ram[s] > 0){
+			print "ramsize: no DWARF for " Module " " s > "/dev/stderr"
+			Failed = 1
+		}
+	}
+	printf "%-10s %4d\n", Module, total
+	Total += total
+}
+BEGIN {
+	Module = ""
+	Total = 0
+	Failed = 0
+	reset()
+}
+/^@OBJ / {
+	finish()
+	reset()
+	Module = $2
+	next
+}
+/^@RAM / {
+	sub(/\.[0-9]+$/, "", $2)			# Static locals carry a suffix
+	Ram[$2]++
+	next
+}
+/^ *<[0-9]+><[0-9a-f]+>: Abbrev Number: [1-9]/ {
+	split($1, f, /[<>]/)
+	Die = f[4]
+	Depth[f[2]] = Die
+	Tag[Die] = $5
+	gsub(/[()]/, "", Tag[Die])
+	sub(/^DW_TAG_/, "", Tag[Die])
+	Count[Die] = 1
+	if(f[2] > 0 && (Tag[Die] == "member" || Tag[Die] == "subrange_type")){
+		p = Depth[f[2] - 1]
+		Kid[p, ++Kids[p]] = Die
+	}
+	next
+}
+/^ *<[0-9a-f]+> +DW_AT_/ {
+	attr = $2
+	sub(/:$/, "", attr)
+	value = $0
+	sub(/^[^:]*: */, "", value)
+	if(attr == "DW_AT_name"){
+		sub(/^\(indirect string, offset: (0x)?[0-9a-f]+\): /, "", value)
+		Name[Die] = value
+	}else if(attr == "DW_AT_type"){
+		gsub(/[<>]/, "", value)
+		sub(/^0x/, "", value)
+		Type[Die] = value
+	}else if(attr == "DW_AT_specification"){	# Definition of an extern
+		gsub(/[<>]/, "", value)
+		sub(/^0x/, "", value)
+		Name[Die] = Name[value]
+		Type[Die] = Type[value]
+	}else if(attr == "DW_AT_byte_size"){
+		Size[Die] = value + 0
+	}else if(attr == "DW_AT_upper_bound"){
+		Count[Die] = value + 1
+	}else if(attr == "DW_AT_count"){
+		Count[Die] = value + 0
+	}else if(attr == "DW_AT_location" && Tag[Die] == "variable" && value ~ /DW_OP_addr/){
+		Var[++Vars] = Die
+	}
+	next
+}
+END {
+	finish()
+	printf "%-10s %4d of %d\n", "total", Total, limit
+	if(Failed){
+		exit 1
+	}else if(Total > limit){
+		print "ramsize: static RAM leaves less than the stack reserve"
+		exit 1
+	}
+}
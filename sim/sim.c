@@ -0,0 +1,573 @@
+/******************************************************************************
+ * sim.c - Host simulation of the AMDRSSTC interrupter.
+ *
+ * The firmware sources are compiled unmodified against the register shim in
+ * this directory and run on a virtual MSP430G2553: the CPU sleeping in LPM0
+ * advances virtual time event by event and the simulator raises the
+ * interrupts the firmware has enabled. Attached models: Timer_A with the
+ * enable output timeline (timer.c), the PCD8544 LCD (lcd.c) and the MIDI UART
+ * (uart.c). The WDT, ADC10 with DTC and the button inputs are modeled here.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#define SIM_DEFINE_REGISTERS
+#include "sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*Board wiring, see includes.h*/
+#define LCD_DC_PIN      BIT6		/*P1.6*/
+#define ENABLE_OUT_PIN  BIT6		/*P2.6*/
+
+#define ADC_OSC_HZ      5000000ULL	/*Typical ADC10OSC*/
+#define MAX_KEYS        16
+#define DEFAULT_TAIL    500			/*ms simulated after the last MIDI byte*/
+
+typedef struct{
+	uint64_t Press;
+	uint64_t Release;
+	int Port;
+	uint8_t Mask;
+}SIM_KEY;
+
+const uint8_t CALBC1_16MHZ = 0x8F;
+const uint8_t CALDCO_16MHZ = 0x95;
+
+uint64_t SimNow = 0;
+int SimGie = 0;
+static int Wake = 0;
+static uint64_t EndTime = SIM_NEVER;
+static const char *LcdPath = "lcd.pgm";
+static const char *FlashPath = NULL;
+static int LcdScale = 4;
+
+static uint16_t WdtLast = 0xFFFF;
+static uint64_t WdtCount = 0;
+
+static uint64_t AdcNext = SIM_NEVER;
+static int AdcChannel;
+static int AdcIndex;
+static uint16_t AdcInput[8] = {512, 512, 512, 512, 512, 512, 512, 512};
+#ifdef SIM_DTC_BUFFER
+extern volatile uint16_t SIM_DTC_BUFFER[];
+#endif
+
+static int SpiPending = 0;
+static int SpiData = 0;
+static int UartTxPending = 0;
+
+static SIM_KEY Keys[MAX_KEYS];
+static int NumKeys = 0;
+
+static void Flush(void);
+static void Normalize(void);
+static uint64_t NextEvent(void);
+static void Advance(uint64_t To);
+static void Service(void);
+static const SIM_VECTOR *Pending(void);
+static const SIM_VECTOR *Vector(int Number);
+static void Pins(void);
+static uint64_t WdtInterval(void);
+static void AdcConvert(void);
+static uint64_t AdcCycles(void);
+static void Finish(void);
+static void Usage(void);
+
+/******************************************************************************
+ * main() - Parses the options, loads the MIDI input and boots the firmware.
+ *****************************************************************************/
+int main(int argc, char **argv){
+	const char *raw = NULL;
+	const char *edges = NULL;
+	const char *tx = NULL;
+	uint64_t start = SIM_CYCLES_US(50000);
+	uint64_t length = 0;
+	int opt;
+	int ch;
+	int value;
+	int port;
+	int bit;
+	double at;
+	double hold;
+
+	while((opt = getopt(argc, argv, "r:s:t:a:k:l:x:e:o:f:h")) != -1){
+		switch(opt){
+		case 'r': raw = optarg; break;
+		case 's': start = SIM_CYCLES_US(atof(optarg) * 1000.0); break;
+		case 't': length = SIM_CYCLES_US(atof(optarg) * 1000.0); break;
+		case 'a':
+			if(sscanf(optarg, "%d=%d", &ch, &value) != 2 || ch < 0 || ch > 7){
+				Usage();
+			}else{}
+			AdcInput[ch] = (uint16_t)(value & 0x3FF);
+			break;
+		case 'k':
+			hold = 100.0;
+			if(NumKeys >= MAX_KEYS
+			   || sscanf(optarg, "%lf:%d.%d:%lf", &at, &port, &bit, &hold) < 3
+			   || port < 1 || port > 2 || bit < 0 || bit > 7){
+				Usage();
+			}else{}
+			Keys[NumKeys].Press = SIM_CYCLES_US(at * 1000.0);
+			Keys[NumKeys].Release = SIM_CYCLES_US((at + hold) * 1000.0);
+			Keys[NumKeys].Port = port;
+			Keys[NumKeys].Mask = (uint8_t)(1 << bit);
+			NumKeys++;
+			break;
+		case 'l': LcdPath = optarg; break;
+		case 'x': LcdScale = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+		case 'e': edges = optarg; break;
+		case 'o': tx = optarg; break;
+		case 'f': FlashPath = optarg; break;
+		default: Usage();
+		}
+	}
+	if(raw){
+		if(UartLoadRaw(raw, start)){
+			return 1;
+		}else{}
+	}else if(optind < argc){
+		if(UartLoadMidiFile(argv[optind], start)){
+			return 1;
+		}else{}
+	}else{}
+	if(edges){
+		TimerEdgeOpen(edges);
+	}else{}
+	if(tx){
+		UartTxOpen(tx);
+	}else{}
+	if(length){
+		EndTime = length;
+	}else if(UartLastByte()){
+		EndTime = UartLastByte() + SIM_CYCLES_US(DEFAULT_TAIL * 1000);
+	}else{
+		EndTime = SIM_CYCLES_US(1000000);
+	}
+
+	IFG2 = (UCA0TXIFG | UCB0TXIFG);			/*Power-up state*/
+	UCA0CTL1 = UCSWRST;
+	UCB0CTL1 = UCSWRST;
+	TimerReset();
+	FlashReset();
+	if(FlashPath){
+		FlashLoad(FlashPath);
+	}else{}
+	Pins();
+	FirmwareMain();
+	Finish();
+	return 0;
+}
+/******************************************************************************
+ * Usage() - Prints the command line help and exits.
+ *****************************************************************************/
+void Usage(void){
+	fprintf(stderr,
+		"usage: amdrsstc-sim [options] [song.mid]\n"
+		"  -r FILE        replay a raw MIDI byte stream instead of a .mid file\n"
+		"  -s MS          start of the MIDI input (default 50)\n"
+		"  -t MS          simulated time (default end of input + %d)\n"
+		"  -a CH=VALUE    ADC input CH reads VALUE, 0-1023 (default 512)\n"
+		"  -k MS:P.B[:HOLD] hold button pin PP.B low at MS for HOLD ms (default 100)\n"
+		"  -l FILE        LCD image, PGM (default lcd.pgm)\n"
+		"  -x SCALE       LCD image scale (default 4)\n"
+		"  -e FILE        enable output edge timeline, CSV\n"
+		"  -o FILE        MIDI TX capture, raw bytes\n"
+		"  -f FILE        flash store segments, loaded at reset and saved at the end\n", DEFAULT_TAIL);
+	exit(2);
+}
+/******************************************************************************
+ * SimFatal(const char *) - Stops the simulation on a state the models cannot
+ * follow.
+ *****************************************************************************/
+void SimFatal(const char *Msg){
+	fprintf(stderr, "sim: %.3f ms: %s\n", SIM_US(SimNow) / 1000.0, Msg);
+	exit(1);
+}
+/******************************************************************************
+ * SimRun(uint64_t) - Lets virtual time pass for busy code, serving interrupts
+ * as they fall due when GIE is set.
+ *****************************************************************************/
+void SimRun(uint64_t Cycles){
+	uint64_t target = SimNow + Cycles;
+	uint64_t next;
+
+	Service();
+	while(SimNow < target){
+		next = NextEvent();
+		Advance(next < target ? next : target);
+		Service();
+	}
+}
+/******************************************************************************
+ * Flush() - Hands transmit buffer writes made since the last access to the
+ * peripheral models.
+ *****************************************************************************/
+void Flush(void){
+	if(SpiPending){
+		SpiPending = 0;
+		LcdWrite(SpiData, UCB0TXBUF);
+	}else{}
+	if(UartTxPending){
+		UartTxPending = 0;
+		UartTxWrite(UCA0TXBUF);
+	}else{}
+}
+/******************************************************************************
+ * Normalize() - Applies register writes that take effect on their own: WDT
+ * counter clears and ADC conversion starts. Timer_A does the same in
+ * TimerNextEvent().
+ *****************************************************************************/
+void Normalize(void){
+	if(WDTCTL != WdtLast){
+		WdtCount = 0;
+		WDTCTL &= ~WDTCNTCL;
+		WdtLast = WDTCTL;
+	}else{}
+	if(!(ADC10CTL0 & ENC) && AdcNext != SIM_NEVER){
+		AdcNext = SIM_NEVER;				/*Sequence stopped*/
+	}else if((ADC10CTL0 & (ADC10ON | ENC | ADC10SC)) == (ADC10ON | ENC | ADC10SC)){
+		ADC10CTL0 &= ~ADC10SC;
+		if(AdcNext == SIM_NEVER){
+			AdcChannel = ADC10CTL1 >> 12;
+			AdcIndex = 0;
+			AdcNext = SimNow + AdcCycles();
+		}else{}
+	}else{}
+}
+/******************************************************************************
+ * NextEvent() - Virtual time of the next hardware event.
+ *****************************************************************************/
+uint64_t NextEvent(void){
+	uint64_t next = EndTime;
+	uint64_t t;
+
+	Normalize();
+	t = WdtInterval();
+	if(t != SIM_NEVER && SimNow + (t - WdtCount) < next){
+		next = SimNow + (t - WdtCount);
+	}else{}
+	if(AdcNext < next){
+		next = AdcNext;
+	}else{}
+	t = TimerNextEvent();
+	if(t < next){
+		next = t;
+	}else{}
+	t = UartNextEvent();
+	if(t < next){
+		next = t;
+	}else{}
+	return next;
+}
+/******************************************************************************
+ * Advance(uint64_t) - Moves every model to To, which must not lie past the
+ * next event, and raises the events due then.
+ *****************************************************************************/
+void Advance(uint64_t To){
+	uint64_t dt = To - SimNow;
+	uint64_t interval;
+
+	Flush();
+	Normalize();
+	Pins();								/*Pin writes made at SimNow*/
+	interval = WdtInterval();
+	TimerAdvance(dt);
+	SimNow = To;
+	if(interval != SIM_NEVER){
+		WdtCount += dt;
+		if(WdtCount >= interval){
+			WdtCount -= interval;
+			if(WDTCTL & WDTTMSEL){
+				IFG1 |= WDTIFG;
+			}else{
+				SimFatal("watchdog reset");
+			}
+		}else{}
+	}else{}
+	if(AdcNext == SimNow){
+		AdcConvert();
+	}else{}
+	if(UartNextEvent() == SimNow){
+		UartEvent();
+	}else{}
+	Pins();
+	if(SimNow >= EndTime){
+		Finish();
+	}else{}
+}
+/******************************************************************************
+ * Service() - Runs pending interrupts in priority order while GIE is set.
+ *****************************************************************************/
+void Service(void){
+	const SIM_VECTOR *v;
+
+	while(SimGie && (v = Pending()) != NULL){
+		SimGie = 0;						/*Cleared on entry, restored by RETI*/
+		v->Isr();
+		Flush();
+		SimGie = 1;
+	}
+}
+/******************************************************************************
+ * Pending() - Finds the highest priority pending interrupt and clears its
+ * flag where the hardware does so on entry. Flags of the TAIV vectors are
+ * cleared for the ISR as its read of TAxIV would.
+ *****************************************************************************/
+const SIM_VECTOR *Pending(void){
+	if((TA1CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+		TA1CCTL0 &= ~CCIFG;
+		return Vector(TIMER1_A0_VECTOR);
+	}else if((TA1CCTL1 & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+		TA1CCTL1 &= ~CCIFG;
+		TA1IV = TA1IV_TACCR1;
+		return Vector(TIMER1_A1_VECTOR);
+	}else if((TA1CCTL2 & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+		TA1CCTL2 &= ~CCIFG;
+		TA1IV = TA1IV_TACCR2;
+		return Vector(TIMER1_A1_VECTOR);
+	}else if((TA1CTL & (TAIE | TAIFG)) == (TAIE | TAIFG)){
+		TA1CTL &= ~TAIFG;
+		TA1IV = TA1IV_TAIFG;
+		return Vector(TIMER1_A1_VECTOR);
+	}else if((IE1 & WDTIE) && (IFG1 & WDTIFG)){
+		IFG1 &= ~WDTIFG;
+		return Vector(WDT_VECTOR);
+	}else if((TA0CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+		TA0CCTL0 &= ~CCIFG;
+		return Vector(TIMER0_A0_VECTOR);
+	}else if((TA0CCTL1 & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+		TA0CCTL1 &= ~CCIFG;
+		TA0IV = TA0IV_TACCR1;
+		return Vector(TIMER0_A1_VECTOR);
+	}else if((TA0CCTL2 & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+		TA0CCTL2 &= ~CCIFG;
+		TA0IV = TA0IV_TACCR2;
+		return Vector(TIMER0_A1_VECTOR);
+	}else if((TA0CTL & (TAIE | TAIFG)) == (TAIE | TAIFG)){
+		TA0CTL &= ~TAIFG;
+		TA0IV = TA0IV_TAIFG;
+		return Vector(TIMER0_A1_VECTOR);
+	}else if((IE2 & UCA0RXIE) && (IFG2 & UCA0RXIFG)){
+		return Vector(USCIAB0RX_VECTOR);	/*Cleared by reading UCA0RXBUF*/
+	}else if((IE2 & UCA0TXIE) && (IFG2 & UCA0TXIFG)){
+		return Vector(USCIAB0TX_VECTOR);	/*Cleared by writing UCA0TXBUF*/
+	}else if((ADC10CTL0 & (ADC10IE | ADC10IFG)) == (ADC10IE | ADC10IFG)){
+		ADC10CTL0 &= ~ADC10IFG;
+		return Vector(ADC10_VECTOR);
+	}else{
+		return NULL;
+	}
+}
+/******************************************************************************
+ * Vector(int) - Looks up the firmware ISR of an interrupt vector.
+ *****************************************************************************/
+const SIM_VECTOR *Vector(int Number){
+	const SIM_VECTOR *v;
+	char msg[64];
+
+	for(v = SimVectors; v->Isr; v++){
+		if(v->Vector == Number){
+			return v;
+		}else{}
+	}
+	snprintf(msg, sizeof(msg), "interrupt vector %d has no ISR in vectors.c", Number);
+	SimFatal(msg);
+	return NULL;
+}
+/******************************************************************************
+ * Pins() - Updates the port inputs from the button script and the enable
+ * output, and feeds the enable output to the edge timeline.
+ *****************************************************************************/
+void Pins(void){
+	uint8_t low[3] = {0, 0, 0};
+	int enable;
+	int i;
+
+	for(i=0;i<NumKeys;i++){
+		if(SimNow >= Keys[i].Press && SimNow < Keys[i].Release){
+			low[Keys[i].Port] |= Keys[i].Mask;
+		}else{}
+	}
+	if(P2SEL & ENABLE_OUT_PIN){
+		enable = TimerOut(0, 1);
+	}else{
+		enable = (P2DIR & P2OUT & ENABLE_OUT_PIN) != 0;
+	}
+	P1IN = (uint8_t)~low[1];				/*Inputs idle high on their pull-ups*/
+	P2IN = (uint8_t)((~low[2] & ~ENABLE_OUT_PIN) | (enable ? ENABLE_OUT_PIN : 0));
+	TimerEdge(enable);
+}
+/******************************************************************************
+ * WdtInterval() - SMCLK cycles per WDT interval, SIM_NEVER while held.
+ *****************************************************************************/
+uint64_t WdtInterval(void){
+	static const uint64_t Divider[4] = {32768, 8192, 512, 64};
+	uint64_t cycles = Divider[WDTCTL & (WDTIS1 | WDTIS0)];
+
+	if(WDTCTL & WDTHOLD){
+		return SIM_NEVER;
+	}else if(WDTCTL & WDTSSEL){				/*ACLK from a 32768 Hz crystal*/
+		return cycles * SIM_SMCLK / 32768;
+	}else{
+		return cycles;
+	}
+}
+/******************************************************************************
+ * AdcCycles() - SMCLK cycles of one ADC10 conversion: sample and hold time
+ * plus 13 conversion clocks.
+ *****************************************************************************/
+uint64_t AdcCycles(void){
+	static const uint64_t Sample[4] = {4, 8, 16, 64};
+	uint64_t clocks = (Sample[(ADC10CTL0 >> 11) & 3] + 13) * (((ADC10CTL1 >> 5) & 7) + 1);
+
+	if((ADC10CTL1 & ADC10SSEL_3) == ADC10SSEL_3){
+		return clocks;
+	}else{
+		return clocks * SIM_SMCLK / ADC_OSC_HZ;
+	}
+}
+/******************************************************************************
+ * AdcConvert() - Completes one conversion of the running sequence. The DTC
+ * moves results to SIM_DTC_BUFFER, the only ADC10SA target this build knows.
+ * BUSY is never reported, polling it would not advance virtual time.
+ *****************************************************************************/
+void AdcConvert(void){
+	int conseq = (ADC10CTL1 >> 1) & 3;
+
+	ADC10MEM = AdcInput[AdcChannel];
+	if(ADC10DTC1){
+#ifdef SIM_DTC_BUFFER
+		if(ADC10SA != (uint16_t)(uintptr_t)SIM_DTC_BUFFER){
+			SimFatal("ADC10SA does not point at the DTC buffer");
+		}else{}
+		SIM_DTC_BUFFER[AdcIndex] = ADC10MEM;
+#else
+		SimFatal("DTC transfer without SIM_DTC_BUFFER");
+#endif
+		AdcIndex++;
+		if(AdcIndex >= ADC10DTC1){
+			AdcIndex = 0;
+			ADC10CTL0 |= ADC10IFG;
+			if(!(ADC10DTC0 & ADC10CT)){
+				AdcNext = SIM_NEVER;		/*Block done, DTC stops*/
+				return;
+			}else{}
+		}else{}
+	}else{
+		ADC10CTL0 |= ADC10IFG;
+	}
+	if((conseq == 1 || conseq == 3) && AdcChannel > 0){
+		AdcChannel--;
+	}else if(conseq >= 2){
+		AdcChannel = ADC10CTL1 >> 12;		/*Repeat*/
+	}else{
+		AdcNext = SIM_NEVER;
+		return;
+	}
+	AdcNext = SimNow + AdcCycles();
+}
+/******************************************************************************
+ * Finish() - Writes the outputs and reports once the simulated time is up.
+ *****************************************************************************/
+void Finish(void){
+	Flush();
+	Pins();
+	LcdSavePgm(LcdPath, LcdScale);
+	if(FlashPath){
+		FlashSave(FlashPath);
+	}else{}
+	printf("sim: %.3f ms simulated\n", SIM_US(SimNow) / 1000.0);
+	UartReport();
+	TimerReport();
+	LcdReport();
+	fflush(stdout);
+	exit(0);
+}
+
+/*Registers with access side effects*/
+volatile uint8_t *SimIfg2(void){
+	Flush();
+	SimRun(SIM_POLL_CYCLES);
+	return &IFG2;
+}
+volatile uint8_t *SimUartRxBuf(void){
+	Flush();
+	IFG2 &= ~UCA0RXIFG;
+	return &UCA0RXBUF;
+}
+volatile uint8_t *SimUartTxBuf(void){
+	Flush();
+	UartTxPending = 1;
+	return &UCA0TXBUF;
+}
+volatile uint8_t *SimSpiTxBuf(void){
+	Flush();
+	SpiPending = 1;
+	SpiData = (P1OUT & LCD_DC_PIN) != 0;
+	return &UCB0TXBUF;
+}
+
+/*Intrinsics*/
+void __bis_SR_register(unsigned short Bits){
+	Flush();
+	if(Bits & GIE){
+		SimGie = 1;
+	}else{}
+	if(Bits & CPUOFF){						/*Sleep until an ISR wakes the CPU*/
+		Wake = 0;
+		Service();
+		while(!Wake){
+			Advance(NextEvent());
+			Service();
+		}
+	}else{
+		Service();
+	}
+}
+void __bic_SR_register(unsigned short Bits){
+	if(Bits & GIE){
+		SimGie = 0;
+	}else{}
+}
+void __bis_SR_register_on_exit(unsigned short Bits){
+	(void)Bits;
+}
+void __bic_SR_register_on_exit(unsigned short Bits){
+	if(Bits & CPUOFF){
+		Wake = 1;
+	}else{}
+}
+void __delay_cycles(unsigned long Cycles){
+	Flush();
+	SimRun(Cycles);
+}
+void __disable_interrupt(void){
+	SimGie = 0;
+}
+void __enable_interrupt(void){
+	SimGie = 1;
+	Service();
+}
+/******************************************************************************
+ * __get_interrupt_state() - Also ends busy waits: a main loop that saves the
+ * interrupt state SIM_SPIN_LIMIT times without time passing is taken to be
+ * waiting on an interrupt (MidiTx() on a full ring), so time is advanced.
+ *****************************************************************************/
+unsigned short __get_interrupt_state(void){
+	static uint64_t spinAt = SIM_NEVER;
+	static int spins = 0;
+	if(SimNow != spinAt){
+		spinAt = SimNow;
+		spins = 0;
+	}else if(SimGie && (++spins >= SIM_SPIN_LIMIT)){
+		Flush();
+		SimRun(SIM_POLL_CYCLES);
+	}else{}
+	return SimGie ? GIE : 0;
+}
+void __set_interrupt_state(unsigned short State){
+	SimGie = (State & GIE) != 0;
+	Service();
+}
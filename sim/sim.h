@@ -0,0 +1,73 @@
+/******************************************************************************
+ * sim.h - Internal interface of the host simulation build.
+ *
+ * Virtual time counts SMCLK cycles (16 MHz). Firmware code runs in zero
+ * virtual time; time only passes while the CPU sleeps in LPM0, in
+ * __delay_cycles() and in IFG2 polling loops.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#ifndef SIM_H
+#define SIM_H
+#define SIM_INTERNAL
+#include <stdint.h>
+#include <stdio.h>
+#include "msp430g2553.h"
+
+/*Defines*/
+#define TRUE  1
+#define FALSE 0
+#define SIM_SMCLK        16000000ULL
+#define SIM_US(c)        ((double)(c) / 16.0)
+#define SIM_CYCLES_US(u) ((uint64_t)(u) * 16ULL)
+#define SIM_NEVER        UINT64_MAX
+#define SIM_POLL_CYCLES  4			/*One flag test and branch*/
+#define SIM_SPIN_LIMIT   64			/*State saves in one instant taken as a busy wait*/
+#define SIM_BYTE_CYCLES  5120		/*10 bits at 31250 baud*/
+
+typedef struct{
+	int Vector;
+	void (*Isr)(void);
+}SIM_VECTOR;
+
+/*sim.c*/
+extern uint64_t SimNow;
+extern int SimGie;
+void SimRun(uint64_t Cycles);
+void SimFatal(const char *Msg);
+
+/*timer.c*/
+void TimerReset(void);
+uint64_t TimerNextEvent(void);
+void TimerAdvance(uint64_t Cycles);
+int TimerOut(int Timer, int Channel);
+void TimerEdge(int Level);
+void TimerEdgeOpen(const char *Path);
+void TimerReport(void);
+
+/*lcd.c*/
+void LcdWrite(int Data, uint8_t Byte);
+void LcdSavePgm(const char *Path, int Scale);
+void LcdReport(void);
+
+/*uart.c*/
+int UartLoadMidiFile(const char *Path, uint64_t Start);
+int UartLoadRaw(const char *Path, uint64_t Start);
+uint64_t UartNextEvent(void);
+void UartEvent(void);
+void UartTxWrite(uint8_t Byte);
+uint64_t UartLastByte(void);
+void UartTxOpen(const char *Path);
+void UartNoteEdge(uint64_t Time);
+void UartReport(void);
+
+/*flash.c*/
+void FlashReset(void);
+void FlashLoad(const char *Path);
+void FlashSave(const char *Path);
+
+/*vectors.c*/
+extern const SIM_VECTOR SimVectors[];
+extern void FirmwareMain(void);
+
+#endif
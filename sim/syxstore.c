@@ -0,0 +1,236 @@
+/******************************************************************************
+ * syxstore.c - Builds a Standard MIDI File that uploads parameters and
+ * lookup tables into the interrupter's flash store (see Store.c).
+ *
+ *   syxstore [-c channel] [-b bendrange] [-p priority] [-d duty%]
+ *            [-f thru] [-o omni] [-t tables.txt] out.mid
+ *
+ * The tables file holds 128 periods (TA0 ticks at SMCLK/4, or at SMCLK/8 for
+ * keys below 35) followed by 128 on times, whitespace separated; a word
+ * starting with # comments out the rest of the line. The THRU options are
+ * the sum of 1 (running status on output), 2 (drop active sensing) and 4
+ * (drop the interrupter's own channel). Parameters not given keep the value
+ * the interrupter has now. The SysEx messages are spaced so the firmware
+ * finishes each flash operation before the next message arrives; play the
+ * file from any sequencer, or feed it to amdrsstc-sim.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*Must match Store.h and SysEx.h*/
+#define SYSEX_ID          0x7D
+#define STORE_BEGIN       0x10
+#define STORE_BLOCK       0x11
+#define STORE_COMMIT      0x12
+#define BLOCK_LEN         16
+#define PARAM_BLOCK       0
+#define PERIOD_BLOCK      1			/*16 blocks of INT16U, little endian*/
+#define ONTIME_BLOCK      17		/*8 blocks*/
+#define ERASED            0xFF
+#define CRC_INIT          0xFFFF
+#define CRC_POLY          0x1021
+
+#define TICKS_PER_MS      2			/*Division 1000 at 500000 us per quarter*/
+#define BEGIN_WAIT_MS     40		/*Segment erase*/
+#define BLOCK_WAIT_MS     12		/*16 bytes programmed and read back*/
+#define COMMIT_WAIT_MS    100
+
+static uint8_t Track[8192];
+static size_t TrackLen = 0;
+static uint32_t Pending = 0;		/*Delta ticks before the next event*/
+
+static void Put(uint8_t Byte);
+static void PutVlq(uint32_t Value);
+static void SysEx(const uint8_t *Body, size_t Len, uint32_t WaitMs);
+static void SendBlock(uint8_t Block, const uint8_t *Data);
+static uint16_t Crc16(const uint8_t *Data, size_t Len);
+static int LoadTables(const char *Path, uint8_t *Image);
+static void Usage(const char *Name);
+
+/******************************************************************************
+ * main(int, char **)
+ *****************************************************************************/
+int main(int argc, char **argv){
+	uint8_t params[BLOCK_LEN];
+	uint8_t tables[(ONTIME_BLOCK + 8 - PERIOD_BLOCK) * BLOCK_LEN];
+	const char *tablePath = NULL;
+	uint8_t body[2];
+	int haveParams = 0;
+	int opt;
+	int v;
+	int i;
+	FILE *f;
+
+	memset(params, ERASED, sizeof(params));
+	while((opt = getopt(argc, argv, "c:b:p:d:f:o:t:")) != -1){
+		v = atoi(optarg);
+		switch(opt){
+		case 'c': if(v < 1 || v > 16){ Usage(argv[0]); }else{} params[0] = (uint8_t)(v - 1); break;
+		case 'b': if(v < 0 || v > 24){ Usage(argv[0]); }else{} params[1] = (uint8_t)v; break;
+		case 'p': if(v < 0 || v > 2){ Usage(argv[0]); }else{} params[2] = (uint8_t)v; break;
+		case 'd': if(v < 1 || v > 50){ Usage(argv[0]); }else{} params[3] = (uint8_t)v; break;
+		case 'f': if(v < 0 || v > 7){ Usage(argv[0]); }else{} params[4] = (uint8_t)v; break;
+		case 'o': if(v < 0 || v > 1){ Usage(argv[0]); }else{} params[5] = (uint8_t)v; break;
+		case 't': tablePath = optarg; break;
+		default: Usage(argv[0]);
+		}
+		haveParams |= (opt != 't');
+	}
+	if(optind != argc - 1 || (!haveParams && !tablePath)){
+		Usage(argv[0]);
+	}else{}
+	if(tablePath && LoadTables(tablePath, tables)){
+		return 1;
+	}else{}
+
+	body[0] = SYSEX_ID;
+	body[1] = STORE_BEGIN;
+	SysEx(body, 2, BEGIN_WAIT_MS);
+	if(haveParams){
+		SendBlock(PARAM_BLOCK, params);
+	}else{}
+	if(tablePath){
+		for(i=PERIOD_BLOCK;i<ONTIME_BLOCK + 8;i++){
+			SendBlock((uint8_t)i, &tables[(i - PERIOD_BLOCK) * BLOCK_LEN]);
+		}
+	}else{}
+	body[1] = STORE_COMMIT;
+	SysEx(body, 2, COMMIT_WAIT_MS);
+	PutVlq(Pending);						/*End of track*/
+	Put(0xFF); Put(0x2F); Put(0x00);
+
+	f = fopen(argv[optind], "wb");
+	if(!f){
+		perror(argv[optind]);
+		return 1;
+	}else{}
+	fwrite("MThd\0\0\0\6\0\0\0\1\3\xE8MTrk", 1, 18, f);	/*Format 0, division 1000*/
+	fputc((int)(TrackLen >> 24), f);
+	fputc((int)(TrackLen >> 16) & 0xFF, f);
+	fputc((int)(TrackLen >> 8) & 0xFF, f);
+	fputc((int)TrackLen & 0xFF, f);
+	fwrite(Track, 1, TrackLen, f);
+	fclose(f);
+	return 0;
+}
+void Usage(const char *Name){
+	fprintf(stderr, "usage: %s [-c channel 1-16] [-b bendrange 0-24] [-p priority 0-2]\n"
+					"       [-d duty%% 1-50] [-f thru 0-7] [-o omni 0-1] [-t tables.txt] out.mid\n", Name);
+	exit(2);
+}
+void Put(uint8_t Byte){
+	if(TrackLen >= sizeof(Track)){
+		fprintf(stderr, "track too long\n");
+		exit(1);
+	}else{}
+	Track[TrackLen++] = Byte;
+}
+void PutVlq(uint32_t Value){
+	int shift;
+	for(shift=21;shift>0;shift-=7){
+		if(Value >> shift){
+			Put((uint8_t)(0x80 | ((Value >> shift) & 0x7F)));
+		}else{}
+	}
+	Put((uint8_t)(Value & 0x7F));
+}
+/******************************************************************************
+ * SysEx(const uint8_t *, size_t, uint32_t) - One F0 ... F7 message followed
+ * by a pause for the firmware.
+ *****************************************************************************/
+void SysEx(const uint8_t *Body, size_t Len, uint32_t WaitMs){
+	size_t i;
+	PutVlq(Pending);
+	Put(0xF0);
+	PutVlq((uint32_t)Len + 1);
+	for(i=0;i<Len;i++){
+		Put(Body[i]);
+	}
+	Put(0xF7);
+	Pending = WaitMs * TICKS_PER_MS;
+}
+/******************************************************************************
+ * SendBlock(uint8_t, const uint8_t *) - Packs a block as groups of up to 7
+ * bytes, each preceded by their top bits, and appends its CRC.
+ *****************************************************************************/
+void SendBlock(uint8_t Block, const uint8_t *Data){
+	uint8_t body[3 + BLOCK_LEN + (BLOCK_LEN + 6) / 7 + 3];
+	size_t n = 0;
+	size_t msb = 0;
+	uint16_t crc = Crc16(Data, BLOCK_LEN);
+	int i;
+
+	body[n++] = SYSEX_ID;
+	body[n++] = STORE_BLOCK;
+	body[n++] = Block;
+	for(i=0;i<BLOCK_LEN;i++){
+		if(i % 7 == 0){
+			msb = n;
+			body[n++] = 0;
+		}else{}
+		body[msb] |= (uint8_t)((Data[i] >> 7) << (i % 7));
+		body[n++] = Data[i] & 0x7F;
+	}
+	body[n++] = crc & 0x7F;
+	body[n++] = (crc >> 7) & 0x7F;
+	body[n++] = crc >> 14;
+	SysEx(body, n, BLOCK_WAIT_MS);
+}
+uint16_t Crc16(const uint8_t *Data, size_t Len){
+	uint16_t crc = CRC_INIT;
+	int i;
+	while(Len--){
+		crc ^= (uint16_t)(*Data++ << 8);
+		for(i=0;i<8;i++){
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ CRC_POLY) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+/******************************************************************************
+ * LoadTables(const char *, uint8_t *) - 128 periods then 128 on times, laid
+ * out as in STORE_IMAGE.
+ *****************************************************************************/
+int LoadTables(const char *Path, uint8_t *Image){
+	FILE *f = fopen(Path, "r");
+	char word[32];
+	char *end;
+	long v;
+	int c;
+	int n = 0;
+
+	if(!f){
+		perror(Path);
+		return 1;
+	}else{}
+	while(n < 256 && fscanf(f, "%31s", word) == 1){
+		if(word[0] == '#'){						/*Comment to end of line*/
+			while((c = fgetc(f)) != EOF && c != '\n'){
+			}
+			continue;
+		}else{}
+		v = strtol(word, &end, 0);
+		if(*end || (n < 128 && (v < 0 || v > 0xFFFF)) || (n >= 128 && (v < 0 || v > 0xFF))){
+			fprintf(stderr, "%s: bad value '%s'\n", Path, word);
+			fclose(f);
+			return 1;
+		}else if(n < 128){
+			Image[2 * n] = (uint8_t)v;
+			Image[2 * n + 1] = (uint8_t)(v >> 8);
+		}else{
+			Image[256 + n - 128] = (uint8_t)v;
+		}
+		n++;
+	}
+	fclose(f);
+	if(n < 256){
+		fprintf(stderr, "%s: %d of 256 values\n", Path, n);
+		return 1;
+	}else{}
+	return 0;
+}
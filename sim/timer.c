@@ -0,0 +1,292 @@
+/******************************************************************************
+ * timer.c - Virtual Timer_A0/A1 and the enable output timeline.
+ *
+ * Both timers count SMCLK through their input divider in up or continuous
+ * mode; compare matches set CCIFG, drive the output units and TAIFG on
+ * rollover. Capture inputs are not modeled, so a channel with CAP set behaves
+ * as a compare channel. Up/down mode is not used by the firmware and stops
+ * the simulation.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "sim.h"
+#include <stdlib.h>
+
+#define NUM_TIMERS   2
+#define NUM_CHANNELS 3
+
+typedef struct{
+	volatile uint16_t *Ctl;
+	volatile uint16_t *R;
+	volatile uint16_t *Cctl[NUM_CHANNELS];
+	volatile uint16_t *Ccr[NUM_CHANNELS];
+	uint32_t Sub;					/*SMCLK cycles into the current count*/
+	int Out[NUM_CHANNELS];
+}SIM_TIMER;
+
+typedef struct{
+	uint64_t Count;
+	uint64_t Min;
+	uint64_t Max;
+	uint64_t Sum;
+}SIM_STAT;
+
+static SIM_TIMER Timers[NUM_TIMERS] = {
+	{&TA0CTL, &TA0R, {&TA0CCTL0, &TA0CCTL1, &TA0CCTL2}, {&TA0CCR0, &TA0CCR1, &TA0CCR2}, 0, {0, 0, 0}},
+	{&TA1CTL, &TA1R, {&TA1CCTL0, &TA1CCTL1, &TA1CCTL2}, {&TA1CCR0, &TA1CCR1, &TA1CCR2}, 0, {0, 0, 0}}
+};
+
+static FILE *EdgeFile = NULL;
+static int EdgeLevel = 0;
+static uint64_t LastRise = SIM_NEVER;
+static SIM_STAT Width;
+static SIM_STAT Period;
+
+static int Running(SIM_TIMER *t);
+static uint32_t Divider(SIM_TIMER *t);
+static uint32_t CountsTo(SIM_TIMER *t, uint16_t Value);
+static uint64_t CyclesTo(SIM_TIMER *t, uint16_t Value);
+static void OutputUnit(SIM_TIMER *t, int Channel, int Equ0);
+static void Sample(SIM_STAT *s, uint64_t Value);
+static void PrintStat(const char *Name, SIM_STAT *s);
+
+/******************************************************************************
+ * TimerReset() - Power-up state: both timers stopped, outputs low.
+ *****************************************************************************/
+void TimerReset(void){
+	int i;
+	int n;
+	for(i=0;i<NUM_TIMERS;i++){
+		Timers[i].Sub = 0;
+		for(n=0;n<NUM_CHANNELS;n++){
+			Timers[i].Out[n] = 0;
+		}
+	}
+}
+/******************************************************************************
+ * TimerOut(int, int) - Level of the output unit of a capture/compare channel.
+ * OUTMOD_0 follows the OUT bit as soon as it is written.
+ *****************************************************************************/
+int TimerOut(int Timer, int Channel){
+	SIM_TIMER *t = &Timers[Timer];
+	if((*t->Cctl[Channel] & OUTMOD_7) == OUTMOD_0){
+		t->Out[Channel] = (*t->Cctl[Channel] & OUT) != 0;
+	}else{}
+	return t->Out[Channel];
+}
+/******************************************************************************
+ * TimerNextEvent() - Virtual time of the next compare match or rollover.
+ * Also applies TACLR and stops on modes the model does not cover.
+ *****************************************************************************/
+uint64_t TimerNextEvent(void){
+	uint64_t next = SIM_NEVER;
+	uint64_t c;
+	SIM_TIMER *t;
+	int i;
+	int n;
+
+	for(i=0;i<NUM_TIMERS;i++){
+		t = &Timers[i];
+		if(*t->Ctl & TACLR){
+			*t->Ctl &= ~TACLR;
+			*t->R = 0;
+			t->Sub = 0;
+		}else{}
+		if((*t->Ctl & MC_3) == MC_3){
+			SimFatal("Timer_A up/down mode is not modeled");
+		}else{}
+		if(Running(t)){
+			for(n=0;n<NUM_CHANNELS;n++){
+				c = CyclesTo(t, *t->Ccr[n]);
+				if(c && SimNow + c < next){
+					next = SimNow + c;
+				}else{}
+			}
+			c = CyclesTo(t, 0);
+			if(c && SimNow + c < next){
+				next = SimNow + c;
+			}else{}
+		}else{}
+	}
+	return next;
+}
+/******************************************************************************
+ * TimerAdvance(uint64_t) - Counts both timers forward and applies the compare
+ * matches that fall exactly at the end of the step.
+ *****************************************************************************/
+void TimerAdvance(uint64_t Cycles){
+	SIM_TIMER *t;
+	uint64_t total;
+	uint64_t ticks;
+	uint32_t top;
+	int hit[NUM_CHANNELS];
+	int wrap;
+	int i;
+	int n;
+
+	for(i=0;i<NUM_TIMERS;i++){
+		t = &Timers[i];
+		if(!Running(t) || Cycles == 0){
+			continue;
+		}else{}
+		for(n=0;n<NUM_CHANNELS;n++){
+			hit[n] = CyclesTo(t, *t->Ccr[n]) == Cycles;
+		}
+		wrap = CyclesTo(t, 0) == Cycles;
+
+		total = t->Sub + Cycles;
+		ticks = total / Divider(t);
+		t->Sub = (uint32_t)(total % Divider(t));
+		if((*t->Ctl & MC_3) == MC_1){
+			top = *t->Ccr[0];
+			if(*t->R > top && ticks){		/*CCR0 moved below the count*/
+				*t->R = 0;
+				ticks--;
+			}else{}
+			*t->R = (uint16_t)((*t->R + ticks) % ((uint64_t)top + 1));
+		}else{
+			*t->R = (uint16_t)(*t->R + ticks);
+		}
+
+		for(n=1;n<NUM_CHANNELS;n++){
+			if(hit[n]){
+				*t->Cctl[n] |= CCIFG;
+				OutputUnit(t, n, FALSE);
+			}else{}
+		}
+		if(hit[0]){
+			*t->Cctl[0] |= CCIFG;
+			for(n=0;n<NUM_CHANNELS;n++){
+				OutputUnit(t, n, TRUE);
+			}
+		}else{}
+		if(wrap){
+			*t->Ctl |= TAIFG;
+		}else{}
+	}
+}
+/******************************************************************************
+ * Running(SIM_TIMER *) - Up mode halts while TACCR0 is zero.
+ *****************************************************************************/
+int Running(SIM_TIMER *t){
+	uint16_t mode = *t->Ctl & MC_3;
+	return (mode == MC_2) || (mode == MC_1 && *t->Ccr[0] != 0);
+}
+/******************************************************************************
+ * Divider(SIM_TIMER *) - Input divider selected by ID.
+ *****************************************************************************/
+uint32_t Divider(SIM_TIMER *t){
+	return 1u << ((*t->Ctl >> 6) & 3);
+}
+/******************************************************************************
+ * CountsTo(SIM_TIMER *, uint16_t) - Timer counts until TAR next equals Value,
+ * 0 if it never will.
+ *****************************************************************************/
+uint32_t CountsTo(SIM_TIMER *t, uint16_t Value){
+	uint32_t r = *t->R;
+	uint32_t top;
+
+	if((*t->Ctl & MC_3) == MC_1){
+		top = *t->Ccr[0];
+		if(Value > top){
+			return 0;
+		}else if(r > top){
+			return Value + 1;
+		}else if(Value > r){
+			return Value - r;
+		}else{
+			return top + 1 - r + Value;
+		}
+	}else{
+		return (uint16_t)(Value - r) ? (uint16_t)(Value - r) : 0x10000;
+	}
+}
+/******************************************************************************
+ * CyclesTo(SIM_TIMER *, uint16_t) - SMCLK cycles until TAR next equals Value,
+ * 0 if it never will.
+ *****************************************************************************/
+uint64_t CyclesTo(SIM_TIMER *t, uint16_t Value){
+	uint64_t counts = CountsTo(t, Value);
+	if(counts == 0){
+		return 0;
+	}else{
+		return counts * Divider(t) - t->Sub;
+	}
+}
+/******************************************************************************
+ * OutputUnit(SIM_TIMER *, int, int) - Output mode actions on EQUn, or on EQU0
+ * when Equ0 is set.
+ *****************************************************************************/
+void OutputUnit(SIM_TIMER *t, int Channel, int Equ0){
+	int *out = &t->Out[Channel];
+	switch(*t->Cctl[Channel] & OUTMOD_7){
+	case OUTMOD_1: if(!Equ0 || Channel == 0){ *out = 1; }else{} break;
+	case OUTMOD_2: if(Equ0 && Channel){ *out = 0; }else{ *out = !*out; } break;
+	case OUTMOD_3: if(Equ0 && Channel){ *out = 0; }else{ *out = 1; } break;
+	case OUTMOD_4: if(!Equ0 || Channel == 0){ *out = !*out; }else{} break;
+	case OUTMOD_5: if(!Equ0 || Channel == 0){ *out = 0; }else{} break;
+	case OUTMOD_6: if(Equ0 && Channel){ *out = 1; }else{ *out = !*out; } break;
+	case OUTMOD_7: if(Equ0 && Channel){ *out = 1; }else{ *out = 0; } break;
+	default: break;
+	}
+}
+/******************************************************************************
+ * TimerEdgeOpen(const char *) - Starts writing the enable output timeline.
+ *****************************************************************************/
+void TimerEdgeOpen(const char *Path){
+	EdgeFile = fopen(Path, "w");
+	if(!EdgeFile){
+		perror(Path);
+		exit(1);
+	}else{}
+	fprintf(EdgeFile, "time_us,level\n");
+}
+/******************************************************************************
+ * TimerEdge(int) - Records the enable output level; called after every step.
+ *****************************************************************************/
+void TimerEdge(int Level){
+	if(Level == EdgeLevel){
+		return;
+	}else{}
+	EdgeLevel = Level;
+	if(EdgeFile){
+		fprintf(EdgeFile, "%.4f,%d\n", SIM_US(SimNow), Level);
+	}else{}
+	if(Level){
+		if(LastRise != SIM_NEVER){
+			Sample(&Period, SimNow - LastRise);
+		}else{}
+		LastRise = SimNow;
+		UartNoteEdge(SimNow);
+	}else if(LastRise != SIM_NEVER){
+		Sample(&Width, SimNow - LastRise);
+	}else{}
+}
+/******************************************************************************
+ * TimerReport() - Prints the pulse width and period spread of the enable
+ * output.
+ *****************************************************************************/
+void TimerReport(void){
+	printf("sim: enable output %llu pulses\n", (unsigned long long)Width.Count);
+	PrintStat("pulse width", &Width);
+	PrintStat("pulse period", &Period);
+	if(EdgeFile){
+		fclose(EdgeFile);
+	}else{}
+}
+void Sample(SIM_STAT *s, uint64_t Value){
+	if(s->Count == 0 || Value < s->Min){
+		s->Min = Value;
+	}else{}
+	if(Value > s->Max){
+		s->Max = Value;
+	}else{}
+	s->Sum += Value;
+	s->Count++;
+}
+void PrintStat(const char *Name, SIM_STAT *s){
+	if(s->Count){
+		printf("sim: %s min %.3f avg %.3f max %.3f us\n", Name, SIM_US(s->Min),
+			   SIM_US(s->Sum) / (double)s->Count, SIM_US(s->Max));
+	}else{}
+}
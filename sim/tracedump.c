@@ -0,0 +1,152 @@
+/******************************************************************************
+ * tracedump.c - Prints the event trace the interrupter sends in reply to
+ * SYSEX_TRACE_DUMP (see Trace.c) as a timeline.
+ *
+ *   tracedump capture.bin
+ *
+ * The input is raw MIDI out as captured by amdrsstc-sim -o or any MIDI
+ * monitor that saves bytes; every trace reply in it is printed. The 16 bit
+ * stamps are unwrapped from the oldest record on, which holds as long as no
+ * two records are 262 ms apart; the slice marks logged by OS_Tick() see to
+ * that. Times are printed in ms from the oldest record.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*Must match SysEx.h and Trace.h*/
+#define SYSEX_ID          0x7D
+#define SYSEX_TRACE_REPLY 0x43		/*SYSEX_TRACE_DUMP | SYSEX_REPLY*/
+#define RECORD_BYTES      7
+#define TRACE_US          4.0		/*Stamp units*/
+#define TRACE_NONE        0x00
+#define TRACE_RX_STATUS   0x01
+#define TRACE_RX_DROP     0x02
+#define TRACE_SYNTH       0x03
+#define TRACE_MODE        0x04
+#define TRACE_SLICE       0x05
+#define TRACE_SLICE_LATE  0x06
+
+static void PrintDump(const uint8_t *Body, size_t Len, int Dump);
+static void PrintEvent(uint8_t Code, uint8_t Arg);
+
+static const char *const ChannelNames[8] = {
+	"NOTE_OFF", "NOTE_ON", "POLY_PRESSURE", "CONTROL", "PROGRAM", "CHANNEL_PRESSURE",
+	"PITCH_BEND", ""
+};
+static const char *const SystemNames[16] = {
+	"SYSEX", "TIME_CODE", "SONG_POSITION", "SONG_SELECT", "F4", "BUS_SELECT",
+	"TUNE_REQUEST", "END_SYSEX", "CLOCK", "F9", "START", "CONTINUE", "STOP", "FD",
+	"ACTIVE_SENSING", "RESET"
+};
+
+/******************************************************************************
+ * main(int, char **)
+ *****************************************************************************/
+int main(int argc, char **argv){
+	FILE *f;
+	uint8_t *buf;
+	long size;
+	size_t i;
+	size_t start;
+	size_t end;
+	int dumps = 0;
+
+	if(argc != 2){
+		fprintf(stderr, "usage: %s capture.bin\n", argv[0]);
+		return 2;
+	}else{}
+	f = fopen(argv[1], "rb");
+	if(!f){
+		perror(argv[1]);
+		return 1;
+	}else{}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(size > 0 ? (size_t)size : 1);
+	size = (long)fread(buf, 1, (size_t)(size > 0 ? size : 0), f);
+	fclose(f);
+
+	for(i=0;i<(size_t)size;i++){
+		if(buf[i] != 0xF0){
+			continue;
+		}else{}
+		start = i + 1;
+		end = start;
+		for(i=start;i < (size_t)size && buf[i] != 0xF7;i++){
+			if(buf[i] < 0xF8){						/*Relayed real-time bytes may fall inside*/
+				buf[end++] = buf[i];
+			}else{}
+		}
+		if(i >= (size_t)size){
+			break;								/*Unterminated*/
+		}else if(end - start > 2 && buf[start] == SYSEX_ID && buf[start + 1] == SYSEX_TRACE_REPLY){
+			PrintDump(&buf[start + 2], end - start - 2, ++dumps);
+		}else{}
+	}
+	free(buf);
+	if(dumps == 0){
+		fprintf(stderr, "%s: no trace dump\n", argv[1]);
+		return 1;
+	}else{}
+	return 0;
+}
+/******************************************************************************
+ * PrintDump(const uint8_t *, size_t, int) - One reply: records of a 3 byte
+ * stamp, 2 byte code and 2 byte argument, oldest first.
+ *****************************************************************************/
+void PrintDump(const uint8_t *Body, size_t Len, int Dump){
+	const uint8_t *r;
+	uint16_t stamp;
+	uint16_t last = 0;
+	uint64_t time = 0;
+	uint8_t code;
+	uint8_t arg;
+	int first = 1;
+	size_t i;
+
+	printf("trace %d: %lu records\n", Dump, (unsigned long)(Len / RECORD_BYTES));
+	for(i=0;i + RECORD_BYTES <= Len;i+=RECORD_BYTES){
+		r = &Body[i];
+		stamp = (uint16_t)(r[0] | (r[1] << 7) | (r[2] << 14));
+		code = (uint8_t)(r[3] | (r[4] << 7));
+		arg = (uint8_t)(r[5] | (r[6] << 7));
+		if(code == TRACE_NONE){
+			continue;							/*Never written*/
+		}else{}
+		if(!first){
+			time += (uint16_t)(stamp - last);
+		}else{}
+		first = 0;
+		last = stamp;
+		printf("%10.3f ms  ", (double)time * TRACE_US / 1000.0);
+		PrintEvent(code, arg);
+	}
+}
+/******************************************************************************
+ * PrintEvent(uint8_t, uint8_t) - One line for a record.
+ *****************************************************************************/
+void PrintEvent(uint8_t Code, uint8_t Arg){
+	if(Code >= 0xF0){
+		printf("%-16s", SystemNames[Code & 0x0F]);
+		if(Code >= 0xF1 && Code <= 0xF5 && Code != 0xF4){
+			printf(" %u", Arg);
+		}else{}
+		printf("\n");
+	}else if(Code & 0x80){
+		printf("%-16s ch %-2u %u\n", ChannelNames[(Code >> 4) & 0x07], (Code & 0x0F) + 1, Arg);
+	}else{
+		switch(Code){
+		case TRACE_RX_STATUS:  printf("rx status        %02X\n", Arg); break;
+		case TRACE_RX_DROP:    printf("rx dropped       %02X\n", Arg); break;
+		case TRACE_SYNTH:      printf("synth key        %u%s\n", Arg, Arg ? "" : " (silent)"); break;
+		case TRACE_MODE:       printf("mode             %s\n", Arg ? "manual" : "midi"); break;
+		case TRACE_SLICE:      printf("slice            %u\n", Arg); break;
+		case TRACE_SLICE_LATE: printf("slice missed     %u\n", Arg); break;
+		default:               printf("event %02X        %u\n", Code, Arg); break;
+		}
+	}
+}
@@ -0,0 +1,435 @@
+/******************************************************************************
+ * uart.c - Virtual USCI A0 at 31250 baud: MIDI input replay, THRU/TX capture
+ * and note latency measurement.
+ *
+ * Input comes from a Standard MIDI File (format 0 or 1, tempo map applied)
+ * or a raw byte stream. Bytes arrive one stop bit after the previous one at
+ * the earliest, so dense passages queue up on the wire as they would from a
+ * real sequencer. The latency of a note is taken from the end of its NOTE_ON
+ * message to the next rising edge of the enable output.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "sim.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LATENCY_TIMEOUT SIM_CYCLES_US(100000)	/*No output for the note*/
+#define PENDING_LEN     256
+
+typedef struct{
+	uint64_t Time;				/*End of the stop bit*/
+	uint8_t Byte;
+	uint8_t NoteOn;				/*Last byte of a sounding NOTE_ON*/
+}SIM_RX_BYTE;
+
+typedef struct{
+	uint32_t Tick;
+	uint32_t Order;				/*File order, keeps the sort stable*/
+	uint32_t Tempo;				/*us per quarter note, tempo events only*/
+	const uint8_t *Data;		/*SysEx body in the file buffer*/
+	uint32_t Len;
+	uint8_t Msg[3];
+	uint8_t Kind;
+}SMF_EVENT;
+
+#define SMF_SHORT  0
+#define SMF_SYSEX  1
+#define SMF_ESCAPE 2
+#define SMF_TEMPO  3
+
+static SIM_RX_BYTE *Rx = NULL;
+static size_t RxCount = 0;
+static size_t RxAlloc = 0;
+static size_t RxNext = 0;
+static uint64_t LineFree = 0;
+static uint8_t RunningStatus = 0;
+static int DataCount = 0;
+static uint64_t RxOverruns = 0;
+static uint64_t RxDropped = 0;
+
+static uint64_t TxDone = SIM_NEVER;
+static int TxHolding = 0;
+static uint8_t TxHeld;
+static uint64_t TxBytes = 0;
+static uint64_t TxLost = 0;
+static FILE *TxFile = NULL;
+
+static uint64_t Pending[PENDING_LEN];
+static unsigned PendHead = 0;
+static unsigned PendCount = 0;
+static uint64_t *Latency = NULL;
+static size_t LatencyCount = 0;
+static size_t LatencyAlloc = 0;
+static uint64_t NoOutput = 0;
+
+static void Send(uint64_t When, const uint8_t *Bytes, uint32_t Len);
+static void TxStart(uint8_t Byte);
+static int ReadVlq(const uint8_t **p, const uint8_t *End, uint32_t *Value);
+static int CompareEvents(const void *a, const void *b);
+static int CompareTimes(const void *a, const void *b);
+static uint8_t *ReadFile(const char *Path, size_t *Len);
+
+/******************************************************************************
+ * UartLoadRaw(const char *, uint64_t) - Queues a file of raw MIDI bytes back
+ * to back from Start.
+ *****************************************************************************/
+int UartLoadRaw(const char *Path, uint64_t Start){
+	size_t len;
+	uint8_t *buf = ReadFile(Path, &len);
+	if(!buf){
+		return 1;
+	}else{}
+	Send(Start, buf, (uint32_t)len);
+	free(buf);
+	return 0;
+}
+/******************************************************************************
+ * UartLoadMidiFile(const char *, uint64_t) - Merges the tracks of a Standard
+ * MIDI File and queues its channel and SysEx messages from Start. Meta events
+ * other than tempo are dropped.
+ *****************************************************************************/
+int UartLoadMidiFile(const char *Path, uint64_t Start){
+	size_t len;
+	uint8_t *buf = ReadFile(Path, &len);
+	const uint8_t *p;
+	const uint8_t *end;
+	const uint8_t *trackEnd;
+	SMF_EVENT *ev = NULL;
+	size_t count = 0;
+	size_t alloc = 0;
+	uint32_t division;
+	uint32_t tracks;
+	uint32_t chunk;
+	uint32_t tick;
+	uint32_t delta;
+	uint32_t n;
+	uint32_t tempo = 500000;
+	uint32_t lastTick = 0;
+	double us = 0.0;
+	uint8_t status;
+	uint8_t type;
+	size_t i;
+
+	if(!buf){
+		return 1;
+	}else{}
+	end = buf + len;
+	if(len < 14 || memcmp(buf, "MThd", 4)){
+		fprintf(stderr, "%s: not a Standard MIDI File\n", Path);
+		free(buf);
+		return 1;
+	}else{}
+	tracks = (buf[10] << 8) | buf[11];
+	division = (buf[12] << 8) | buf[13];
+	p = buf + 8 + ((buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7]);
+
+	while(tracks && p + 8 <= end){
+		chunk = (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+		trackEnd = p + 8 + chunk > end ? end : p + 8 + chunk;
+		if(memcmp(p, "MTrk", 4)){
+			p = trackEnd;					/*Unknown chunk*/
+			continue;
+		}else{}
+		tracks--;
+		p += 8;
+		tick = 0;
+		status = 0;
+		while(p < trackEnd && ReadVlq(&p, trackEnd, &delta) == 0 && p < trackEnd){
+			tick += delta;
+			if(count == alloc){
+				alloc = alloc ? alloc * 2 : 1024;
+				ev = realloc(ev, alloc * sizeof(SMF_EVENT));
+			}else{}
+			memset(&ev[count], 0, sizeof(SMF_EVENT));
+			ev[count].Tick = tick;
+			ev[count].Order = (uint32_t)count;
+			if(*p == 0xFF){					/*Meta event*/
+				if(p + 2 > trackEnd){
+					break;
+				}else{}
+				type = p[1];
+				p += 2;
+				if(ReadVlq(&p, trackEnd, &n) || p + n > trackEnd){
+					break;
+				}else{}
+				if(type == 0x51 && n == 3){
+					ev[count].Kind = SMF_TEMPO;
+					ev[count].Tempo = (p[0] << 16) | (p[1] << 8) | p[2];
+					count++;
+				}else{}
+				p += n;
+				if(type == 0x2F){
+					break;
+				}else{}
+			}else if(*p == 0xF0 || *p == 0xF7){	/*SysEx or escape*/
+				ev[count].Kind = (*p == 0xF0) ? SMF_SYSEX : SMF_ESCAPE;
+				p++;
+				if(ReadVlq(&p, trackEnd, &n) || p + n > trackEnd){
+					break;
+				}else{}
+				ev[count].Data = p;
+				ev[count].Len = n;
+				count++;
+				p += n;
+				status = 0;
+			}else{
+				if(*p & 0x80){
+					status = *p++;
+				}else if(!status){
+					break;						/*Data without status*/
+				}else{}
+				n = ((status & 0xE0) == 0xC0) ? 1 : 2;
+				if(p + n > trackEnd){
+					break;
+				}else{}
+				ev[count].Kind = SMF_SHORT;
+				ev[count].Msg[0] = status;
+				memcpy(&ev[count].Msg[1], p, n);
+				ev[count].Len = n + 1;
+				count++;
+				p += n;
+			}
+		}
+		p = trackEnd;
+	}
+	qsort(ev, count, sizeof(SMF_EVENT), CompareEvents);
+
+	for(i=0;i<count;i++){
+		if(division & 0x8000){				/*SMPTE frames and ticks per frame*/
+			us += (double)(ev[i].Tick - lastTick) * 1e6
+				  / ((double)(256 - (division >> 8)) * (double)(division & 0xFF));
+		}else{
+			us += (double)(ev[i].Tick - lastTick) * (double)tempo / (double)division;
+		}
+		lastTick = ev[i].Tick;
+		if(ev[i].Kind == SMF_TEMPO){
+			tempo = ev[i].Tempo;
+		}else if(ev[i].Kind == SMF_SHORT){
+			Send(Start + SIM_CYCLES_US(us), ev[i].Msg, ev[i].Len);
+		}else if(ev[i].Kind == SMF_SYSEX){
+			static const uint8_t SysEx = 0xF0;
+			Send(Start + SIM_CYCLES_US(us), &SysEx, 1);
+			Send(Start + SIM_CYCLES_US(us), ev[i].Data, ev[i].Len);
+		}else{
+			Send(Start + SIM_CYCLES_US(us), ev[i].Data, ev[i].Len);
+		}
+	}
+	free(ev);
+	free(buf);
+	return 0;
+}
+/******************************************************************************
+ * Send(uint64_t, const uint8_t *, uint32_t) - Queues bytes on the wire from
+ * When on, tagging the end of every sounding NOTE_ON.
+ *****************************************************************************/
+void Send(uint64_t When, const uint8_t *Bytes, uint32_t Len){
+	uint32_t i;
+	uint8_t b;
+
+	for(i=0;i<Len;i++){
+		if(RxCount == RxAlloc){
+			RxAlloc = RxAlloc ? RxAlloc * 2 : 4096;
+			Rx = realloc(Rx, RxAlloc * sizeof(SIM_RX_BYTE));
+		}else{}
+		b = Bytes[i];
+		LineFree = (When > LineFree ? When : LineFree) + SIM_BYTE_CYCLES;
+		Rx[RxCount].Time = LineFree;
+		Rx[RxCount].Byte = b;
+		Rx[RxCount].NoteOn = FALSE;
+		if(b >= 0xF8){						/*Real time, status unaffected*/
+		}else if(b & 0x80){
+			RunningStatus = (b < 0xF0) ? b : 0;
+			DataCount = 0;
+		}else if((RunningStatus & 0xF0) == 0x90){
+			DataCount++;
+			if(DataCount == 2){				/*Velocity*/
+				DataCount = 0;
+				Rx[RxCount].NoteOn = b != 0;
+			}else{}
+		}else{}
+		RxCount++;
+	}
+}
+/******************************************************************************
+ * UartLastByte() - Arrival of the last queued byte, 0 without input.
+ *****************************************************************************/
+uint64_t UartLastByte(void){
+	return RxCount ? Rx[RxCount - 1].Time : 0;
+}
+/******************************************************************************
+ * UartNextEvent() - Next byte arrival or end of a transmitted byte.
+ *****************************************************************************/
+uint64_t UartNextEvent(void){
+	uint64_t next = TxDone;
+	if(RxNext < RxCount && Rx[RxNext].Time < next){
+		next = Rx[RxNext].Time;
+	}else{}
+	return next;
+}
+/******************************************************************************
+ * UartEvent() - Delivers the byte arriving now and moves the transmit buffer
+ * into the shift register when the previous byte is out. A byte arriving
+ * before the last one was read overruns the receiver.
+ *****************************************************************************/
+void UartEvent(void){
+	if(RxNext < RxCount && Rx[RxNext].Time == SimNow){
+		if(UCA0CTL1 & UCSWRST){
+			RxDropped++;
+		}else{
+			if(IFG2 & UCA0RXIFG){
+				UCA0STAT |= UCOE;
+				RxOverruns++;
+			}else{}
+			UCA0RXBUF = Rx[RxNext].Byte;
+			IFG2 |= UCA0RXIFG;
+			if(Rx[RxNext].NoteOn){
+				if(PendCount == PENDING_LEN){
+					NoOutput++;				/*Oldest dropped unmeasured*/
+					PendHead = (PendHead + 1) % PENDING_LEN;
+					PendCount--;
+				}else{}
+				Pending[(PendHead + PendCount) % PENDING_LEN] = SimNow;
+				PendCount++;
+			}else{}
+		}
+		RxNext++;
+	}else{}
+	if(TxDone == SimNow){
+		TxDone = SIM_NEVER;
+		if(TxHolding){
+			TxHolding = FALSE;
+			TxStart(TxHeld);
+		}else{}
+	}else{}
+}
+/******************************************************************************
+ * UartTxWrite(uint8_t) - A write to UCA0TXBUF. The byte goes straight to the
+ * shift register when it is idle, otherwise it waits in the buffer with
+ * UCA0TXIFG clear.
+ *****************************************************************************/
+void UartTxWrite(uint8_t Byte){
+	if(UCA0CTL1 & UCSWRST){
+		return;
+	}else if(TxDone == SIM_NEVER){
+		TxStart(Byte);
+	}else if(!TxHolding){
+		TxHolding = TRUE;
+		TxHeld = Byte;
+		IFG2 &= ~UCA0TXIFG;
+	}else{
+		TxLost++;							/*Written while UCA0TXIFG was clear*/
+		TxHeld = Byte;
+	}
+}
+void TxStart(uint8_t Byte){
+	TxDone = SimNow + SIM_BYTE_CYCLES;
+	IFG2 |= UCA0TXIFG;
+	TxBytes++;
+	if(TxFile){
+		fputc(Byte, TxFile);
+	}else{}
+}
+/******************************************************************************
+ * UartTxOpen(const char *) - Captures transmitted bytes to a file.
+ *****************************************************************************/
+void UartTxOpen(const char *Path){
+	TxFile = fopen(Path, "wb");
+	if(!TxFile){
+		perror(Path);
+		exit(1);
+	}else{}
+}
+/******************************************************************************
+ * UartNoteEdge(uint64_t) - A rising edge of the enable output; ends the
+ * latency of every NOTE_ON received before it.
+ *****************************************************************************/
+void UartNoteEdge(uint64_t Time){
+	uint64_t start;
+	while(PendCount){
+		start = Pending[PendHead];
+		if(start > Time){
+			break;
+		}else{}
+		PendHead = (PendHead + 1) % PENDING_LEN;
+		PendCount--;
+		if(Time - start > LATENCY_TIMEOUT){
+			NoOutput++;
+		}else{
+			if(LatencyCount == LatencyAlloc){
+				LatencyAlloc = LatencyAlloc ? LatencyAlloc * 2 : 1024;
+				Latency = realloc(Latency, LatencyAlloc * sizeof(uint64_t));
+			}else{}
+			Latency[LatencyCount++] = Time - start;
+		}
+	}
+}
+/******************************************************************************
+ * UartReport() - Prints the byte counts and the note latency distribution.
+ *****************************************************************************/
+void UartReport(void){
+	printf("sim: MIDI in %llu of %llu bytes, %llu overruns, %llu dropped in reset\n",
+		   (unsigned long long)RxNext, (unsigned long long)RxCount,
+		   (unsigned long long)RxOverruns, (unsigned long long)RxDropped);
+	printf("sim: MIDI out %llu bytes, %llu lost\n",
+		   (unsigned long long)TxBytes, (unsigned long long)TxLost);
+	NoOutput += PendCount;
+	if(LatencyCount){
+		qsort(Latency, LatencyCount, sizeof(uint64_t), CompareTimes);
+		printf("sim: note latency n=%llu p50 %.1f p90 %.1f p99 %.1f max %.1f us, %llu without output\n",
+			   (unsigned long long)LatencyCount,
+			   SIM_US(Latency[LatencyCount / 2]),
+			   SIM_US(Latency[LatencyCount * 9 / 10]),
+			   SIM_US(Latency[LatencyCount * 99 / 100]),
+			   SIM_US(Latency[LatencyCount - 1]),
+			   (unsigned long long)NoOutput);
+	}else if(NoOutput){
+		printf("sim: %llu notes without output\n", (unsigned long long)NoOutput);
+	}else{}
+	if(TxFile){
+		fclose(TxFile);
+	}else{}
+}
+
+int ReadVlq(const uint8_t **p, const uint8_t *End, uint32_t *Value){
+	uint32_t v = 0;
+	int i;
+	for(i=0;i<4 && *p < End;i++){
+		v = (v << 7) | (**p & 0x7F);
+		if(!(*(*p)++ & 0x80)){
+			*Value = v;
+			return 0;
+		}else{}
+	}
+	return 1;
+}
+int CompareEvents(const void *a, const void *b){
+	const SMF_EVENT *x = a;
+	const SMF_EVENT *y = b;
+	if(x->Tick != y->Tick){
+		return x->Tick < y->Tick ? -1 : 1;
+	}else{
+		return x->Order < y->Order ? -1 : (x->Order > y->Order);
+	}
+}
+int CompareTimes(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : (x > y);
+}
+uint8_t *ReadFile(const char *Path, size_t *Len){
+	FILE *f = fopen(Path, "rb");
+	uint8_t *buf;
+	long size;
+	if(!f){
+		perror(Path);
+		return NULL;
+	}else{}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(size > 0 ? (size_t)size : 1);
+	*Len = fread(buf, 1, (size_t)(size > 0 ? size : 0), f);
+	fclose(f);
+	return buf;
+}
@@ -0,0 +1,25 @@
+/******************************************************************************
+ * vectors.c - Interrupt vector table of the simulation build. Keep in step
+ * with the #pragma vector declarations in the firmware; a pending interrupt
+ * without an entry here stops the simulation.
+ *
+ * WWU EET Senior Project - AMDRSSTC Interrupter
+ *****************************************************************************/
+#include "sim.h"
+
+void OS_Tick(void);
+void TimeRollover(void);
+void MIDI_RX(void);
+void MIDI_TX(void);
+void SynthPulseEnd(void);
+void GateEdge(void);
+
+const SIM_VECTOR SimVectors[] = {
+	{WDT_VECTOR,       OS_Tick},			/*main.c*/
+	{TIMER1_A0_VECTOR, TimeRollover},		/*main.c*/
+	{USCIAB0RX_VECTOR, MIDI_RX},			/*MIDI.c*/
+	{USCIAB0TX_VECTOR, MIDI_TX},			/*MIDI.c*/
+	{TIMER0_A0_VECTOR, SynthPulseEnd},		/*Synth.c*/
+	{TIMER1_A1_VECTOR, GateEdge},			/*Clock.c*/
+	{0, NULL}
+};